@@ -15,6 +15,15 @@
 //	of the directory cannot expand.  In other words, once all the
 //	entries in the directory are used, no more files can be created.
 //
+//	The table doubles as an open-addressing hash table: a name is
+//	stored at the first free entry at or after the slot its hash
+//	picks ("home" slot), so a lookup only scans from the home slot
+//	to the next free entry instead of the whole table.  Since the
+//	placement is part of the table, it is saved on disk along with
+//	it, and FetchFrom/WriteBack are unchanged.  Removing an entry
+//	shifts later entries of the same probe run back, so no run is
+//	ever broken by a hole.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -65,6 +74,9 @@ Directory::FetchFrom(OpenFile *file)
   int size = file->getSize(); // get dir num
   tableSize = size;
     (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+  if (!IsHashed()) {	// written by a version that did not hash names
+    Rehash();
+  }
 }
 
 //----------------------------------------------------------------------
@@ -91,12 +103,83 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
+    int i = HomeSlot(name);
+
+    for (int probes = 0; probes < tableSize; probes++) {
+        if (!table[i].inUse)
+	    return -1;		// end of the probe run, not there
+        if (!strncmp(table[i].name, name, FileNameMaxLen))
 	    return i;
+	i = (i + 1) % tableSize;
+    }
     return -1;		// name not in directory
 }
 
+//----------------------------------------------------------------------
+// Directory::HomeSlot
+// 	Return the entry where the search for "name" starts: a hash of
+//	the (at most FileNameMaxLen) characters of the name, modulo the
+//	size of the table.
+//
+//	"name" -- the file name to hash
+//----------------------------------------------------------------------
+
+int
+Directory::HomeSlot(char *name)
+{
+    unsigned int hash = 5381;
+
+    for (int i = 0; i < FileNameMaxLen && name[i] != '\0'; i++)
+	hash = hash * 33 + (unsigned char) name[i];
+    return hash % tableSize;
+}
+
+//----------------------------------------------------------------------
+// Directory::IsHashed
+// 	Return TRUE if every entry in use can be found from its home slot,
+//	that is, there is no free entry between its home slot and itself.
+//----------------------------------------------------------------------
+
+bool
+Directory::IsHashed()
+{
+    for (int i = 0; i < tableSize; i++) {
+	if (!table[i].inUse)
+	    continue;
+	for (int j = HomeSlot(table[i].name); j != i; j = (j + 1) % tableSize)
+	    if (!table[j].inUse)
+		return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::Rehash
+// 	Put every entry in use back at the right place for its name.
+//	Used for directories written before names were hashed, and when
+//	the table changes size.
+//----------------------------------------------------------------------
+
+void
+Directory::Rehash()
+{
+    DirectoryEntry *old = new DirectoryEntry[tableSize];
+
+    for (int i = 0; i < tableSize; i++) {
+	old[i] = table[i];
+	table[i].inUse = FALSE;
+    }
+    for (int i = 0; i < tableSize; i++) {
+	if (!old[i].inUse)
+	    continue;
+	int j = HomeSlot(old[i].name);
+	while (table[j].inUse)
+	    j = (j + 1) % tableSize;
+	table[j] = old[i];
+    }
+    delete [] old;
+}
+
 //----------------------------------------------------------------------
 // Directory::Find
 // 	Look up file name in directory, and return the disk sector number
@@ -133,7 +216,9 @@ Directory::Add(char *name, int newSector)
     if (FindIndex(name) != -1)
 	return FALSE;
 
-    for (int i = 0; i < tableSize; i++)
+    // take the first free entry of the probe run
+    for (int probes = 0, i = HomeSlot(name); probes < tableSize; 
+		probes++, i = (i + 1) % tableSize)
         if (!table[i].inUse) {
             table[i].inUse = TRUE;
             strncpy(table[i].name, name, FileNameMaxLen); 
@@ -161,6 +246,10 @@ Directory::Add(char *name, int newSector)
 // 	Remove a file name from the directory.  Return TRUE if successful;
 //	return FALSE if the file isn't in the directory. 
 //
+//	Entries after the removed one that could not be placed at their
+//	home slot are moved back into the hole, so that every probe run
+//	stays unbroken.
+//
 //	"name" -- the file name to be removed
 //----------------------------------------------------------------------
 
@@ -172,6 +261,20 @@ Directory::Remove(char *name)
     if (i == -1)
 	return FALSE; 		// name not in directory
     table[i].inUse = FALSE;
+
+    for (int hole = i, j = (i + 1) % tableSize; table[j].inUse;
+		j = (j + 1) % tableSize) {
+	int home = HomeSlot(table[j].name);
+
+	// entry j may move into the hole only if that does not put it
+	// before its home slot
+	if ((j - home + tableSize) % tableSize >= 
+			(j - hole + tableSize) % tableSize) {
+	    table[hole] = table[j];
+	    table[j].inUse = FALSE;
+	    hole = j;
+	}
+    }
     return TRUE;	
 }
 
@@ -252,16 +355,19 @@ Directory::getEntrySize() {
 
 bool 
 Directory::Expand(int size) {
+  int oldSize = tableSize;
   tableSize = tableSize + size;
   DirectoryEntry *newTable = new DirectoryEntry[tableSize];  // create new table for new size
   for (int i = 0; i < tableSize; ++i) {     // copy the old table
-    if (i < tableSize)
+    if (i < oldSize)
       newTable[i] = table[i];
     else
       newTable[i].inUse = FALSE;
   }
   //delete[] table;
   table = newTable;
+  Rehash(); // home slots depend on the table size
+  return TRUE;
 }
 
 int
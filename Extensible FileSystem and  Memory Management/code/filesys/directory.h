@@ -44,6 +44,9 @@ class DirectoryEntry {
 // The directory data structure can be stored in memory, or on disk.
 // When it is on disk, it is stored as a regular Nachos file.
 //
+// Entries are placed by a hash of their name, with linear probing,
+// so that Find, Add and Remove look at only a few entries.
+//
 // The constructor initializes a directory structure in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
 // from/to disk. 
@@ -91,6 +94,10 @@ class Directory {
 
     int FindIndex(char *name);		// Find the index into the directory 
 					//  table corresponding to "name"
+    int HomeSlot(char *name);		// Where the probe for "name" starts
+    bool IsHashed();			// Is every entry reachable from
+					//  its home slot?
+    void Rehash();			// Re-place every entry by its hash
     //char* fullDir; // set when make dir
 };
 
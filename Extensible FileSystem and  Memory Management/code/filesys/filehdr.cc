@@ -27,11 +27,26 @@
 #include "filehdr.h"
 #include "debug.h"
 #include "synchdisk.h"
+#include "sectorcache.h"
 #include "main.h"
 
 
+//----------------------------------------------------------------------
+// FileBlock::Allocate
+// 	Allocate the data sectors for a new block of the file.  We look
+//	for one contiguous run of sectors starting at or after "goal", so
+//	that reading the block back is one seek followed by sectors
+//	streaming off the same track.  If the disk is too fragmented for
+//	that, each sector is placed as close as possible to the one
+//	before it.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"fileSize" is the number of bytes the block is to hold
+//	"goal" is where we would like the data to start
+//----------------------------------------------------------------------
+
 int
-FileBlock::Allocate(PersistentBitmap *freeMap, int fileSize)
+FileBlock::Allocate(PersistentBitmap *freeMap, int fileSize, int goal)
 {
   DEBUG(dbgFile, " - Allocate at file block, size: " << fileSize);
   numBytes = fileSize;
@@ -41,8 +56,18 @@ FileBlock::Allocate(PersistentBitmap *freeMap, int fileSize)
     return -1;		// not enough space
   }
 
+  int run = -1;
+  if (numSectors > 0) {
+    run = freeMap->FindRunNear(goal, numSectors, NumInode + 2, NumSectors);
+  }
   for (int i = 0; i < numSectors; i++) {
-    dataSectors[i] = freeMap->FindAndSetRange(NumInode + 2, NumSectors);
+    if (run != -1) {
+      dataSectors[i] = run + i;
+      freeMap->Mark(dataSectors[i]);
+    } else {
+      dataSectors[i] = freeMap->AllocateNear(goal, NumInode + 2, NumSectors);
+      goal = dataSectors[i] + 1;
+    }
     DEBUG(dbgFile, " - Allocated sector: " << dataSectors[i]);
     // since we checked that there was enough free space,
     // we expect this to succeed
@@ -66,13 +91,13 @@ FileBlock::Deallocate(PersistentBitmap *freeMap)
 void
 FileBlock::FetchFrom(int sector)
 {
-  kernel->synchDisk->ReadSector(sector, (char *)this);
+  kernel->sectorCache->ReadSector(sector, (char *)this);
 }
 
 void
 FileBlock::WriteBack(int sector)
 {
-  kernel->synchDisk->WriteSector(sector, (char *)this);
+  kernel->sectorCache->WriteSector(sector, (char *)this);
 }
 
 int
@@ -123,13 +148,19 @@ FileBlock::Expand(PersistentBitmap *freeMap, int expendedSize) {
 
   requiredByte = requiredByte - remain;
 
+  int goal = LastSector() + 1; // keep growing the file where it ends
+  if (goal == 0) {
+    goal = NumInode + 2;
+  }
+
   if (remain == SectorSize) { // block not assigned yet
     if (freeMap->NumClearRange(NumInode + 2, NumSectors) < 1) {
       DEBUG(dbgFile, " - Not enough space: " << 1);
       return -1;		// not enough space
     }
 
-    dataSectors[index] = freeMap->FindAndSetRange(NumInode + 2, NumSectors);
+    dataSectors[index] = freeMap->AllocateNear(goal, NumInode + 2, NumSectors);
+    goal = dataSectors[index] + 1;
   }
 
   DEBUG(dbgFile, " - Expand at file block, size: " << expendedSize);
@@ -146,7 +177,8 @@ FileBlock::Expand(PersistentBitmap *freeMap, int expendedSize) {
       break;
     }
     if (dataSectors[i] == -1) { // empty
-      dataSectors[i] = freeMap->FindAndSetRange(NumInode + 2, NumSectors);
+      dataSectors[i] = freeMap->AllocateNear(goal, NumInode + 2, NumSectors);
+      goal = dataSectors[i] + 1;
       allocatedSectors++;
       allocatedSize = allocatedSize + SectorSize;
       DEBUG(dbgFile, " - Expand at file block, size: " << allocatedSize);
@@ -159,6 +191,23 @@ FileBlock::Expand(PersistentBitmap *freeMap, int expendedSize) {
   return allocatedSize;
 }
 
+//----------------------------------------------------------------------
+// FileBlock::LastSector
+// 	Return the last data sector allocated to this block, or -1 if
+//	there is none yet.
+//----------------------------------------------------------------------
+
+int
+FileBlock::LastSector()
+{
+  for (int i = NumInDirect - 1; i >= 0; i--) {
+    if (dataSectors[i] != -1) {
+      return dataSectors[i];
+    }
+  }
+  return -1;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
@@ -166,6 +215,10 @@ FileBlock::Expand(PersistentBitmap *freeMap, int expendedSize) {
 //	Return FALSE if there are not enough free blocks to accomodate
 //	the new file.
 //
+//	New blocks are placed right after the last data sector of the
+//	file, and their data right after them, so that the file stays
+//	contiguous on disk as long as there is room.
+//
 //	"freeMap" is the bit map of free disk sectors
 //	"fileSize" is the size of file to allocate
 //----------------------------------------------------------------------
@@ -181,6 +234,7 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
     if (fileSize == 0) {
       firstBlock = -1;
       lastBlock = -1;
+      ClearIndex();
       return TRUE;
     }
 
@@ -192,6 +246,7 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
     int allocateSize = MaxBlockSize;
     int allocatedSize = 0;
     int preSector = -1;
+    int goal = NumInode + 2; // where the next sector should go
     int i = 0;
     DEBUG(dbgFile, "[First sector] " << firstBlock << "[Last sector] " << lastBlock << "[Previous numbyte] " << numBytes << "[Required]: " << requiredSize << "[Allocated]: " << allocatedSize);
 
@@ -204,6 +259,12 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
       allocatedSize = newBlock->Expand(freeMap, allocateSize);
       requiredSize = requiredSize - allocatedSize; // update require size
       newBlock->WriteBack(lastBlock);
+      if (newBlock->LastSector() != -1) {
+        goal = newBlock->LastSector() + 1;
+      }
+      if (indexValid && numIndexed > 0) {
+        IndexBlock(numIndexed - 1, newBlock); // last block has grown
+      }
       preBlock = newBlock;
     }
 
@@ -214,7 +275,7 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
       DEBUG(dbgFile, "[allocated]: " << allocatedSize);
 
       newBlock = new FileBlock(); // new block
-      int allocatedSector = freeMap->FindAndSetRange(NumInode + 2, NumSectors);
+      int allocatedSector = freeMap->AllocateNear(goal, NumInode + 2, NumSectors);
       DEBUG(dbgFile, "Allocating sector: " << allocatedSector);
       if ((requiredSize - allocatedSize) >= MaxBlockSize) {
         allocateSize = MaxBlockSize;
@@ -225,8 +286,9 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
 
       DEBUG(dbgFile, "[allocated after]: " << allocateSize);
 
-      if (newBlock->Allocate(freeMap, allocateSize) == -1) {
+      if (newBlock->Allocate(freeMap, allocateSize, allocatedSector + 1) == -1) {
         DEBUG(dbgFile, "Allocating fail");
+        ClearIndex(); // chain is half built, rebuild it when needed
         return FALSE; // allocation fail
       }
       if (firstBlock == -1) { // no data before
@@ -237,6 +299,12 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
         preBlock->WriteBack(preSector);
       }
       newBlock->WriteBack(allocatedSector); // flush the disk at the allocated sector
+      if (newBlock->LastSector() != -1) {
+        goal = newBlock->LastSector() + 1;
+      }
+      if (indexValid) {
+        IndexBlock(numIndexed, newBlock); // append to the sector index
+      }
       allocatedSize = allocatedSize + allocateSize;
 
       if (preBlock != NULL) {
@@ -257,6 +325,23 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::GrowthSectors
+// 	Return the most sectors (data plus FileBlocks) that Allocate can
+//	take from the data area of the disk to add "fileSize" bytes to a
+//	file, however full its last sector and last FileBlock already are.
+//----------------------------------------------------------------------
+
+int
+FileHeader::GrowthSectors(int fileSize)
+{
+    if (fileSize == 0) {
+      return 0;
+    }
+    return divRoundUp(fileSize, SectorSize) + 1		// data
+	   + divRoundUp(fileSize, MaxBlockSize) + 1;	// FileBlocks
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
 // 	De-allocate all the space allocated for data blocks for this file.
@@ -282,6 +367,7 @@ FileHeader::Deallocate(PersistentBitmap *freeMap)
   }
   firstBlock = -1;
   lastBlock = -1;
+  ClearIndex();
 }
 
 //----------------------------------------------------------------------
@@ -294,7 +380,8 @@ FileHeader::Deallocate(PersistentBitmap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
-    kernel->synchDisk->ReadSector(sector, (char *)this);
+    kernel->sectorCache->ReadSector(sector, (char *)this);
+    ClearIndex();			// index belongs to the old contents
 }
 
 //----------------------------------------------------------------------
@@ -307,7 +394,7 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
-    kernel->synchDisk->WriteSector(sector, (char *)this); 
+    kernel->sectorCache->WriteSector(sector, (char *)this); 
 }
 
 //----------------------------------------------------------------------
@@ -323,25 +410,94 @@ FileHeader::WriteBack(int sector)
 int
 FileHeader::ByteToSector(int offset)
 {
-  int index = offset / MaxBlockSize;
-  int blocknum = (offset % MaxBlockSize) / SectorSize;
-  FileBlock *block;
-  int blockFetched = firstBlock;
+  int index = offset / SectorSize;
 
-  for (int i = 0; i < numSectors; i++) {
-    block = new FileBlock();
-    block->FetchFrom(blockFetched);
-    if (i == index) { // corresponding FileBlock
-      int result = block->ByteToSector(offset % MaxBlockSize);
-      delete block;
-
-      DEBUG(dbgFile, " => index:" << index << " is at block no. " << blocknum);
-      DEBUG(dbgFile, " ** The offset:" << offset << " is at block " << result);
-      return result;
+  if (!indexValid) {
+    BuildIndex();
+  }
+  if (offset < 0 || index >= numIndexed * (int)NumInDirect) {
+    DEBUG(dbgFile, " ** The offset:" << offset << " is past the last block");
+    return -1;
+  }
+
+  DEBUG(dbgFile, " => index:" << index / NumInDirect << " is at block no. " << index % NumInDirect);
+  DEBUG(dbgFile, " ** The offset:" << offset << " is at block " << sectorIndex[index]);
+  return sectorIndex[index];
+}
+
+//----------------------------------------------------------------------
+// FileHeader::BuildIndex
+// 	Walk the chain of FileBlocks, from firstBlock to lastBlock, and
+//	record every data sector in the in-memory sector index.  After
+//	this, ByteToSector needs no disk I/O at all.
+//----------------------------------------------------------------------
+
+void
+FileHeader::BuildIndex()
+{
+  FileBlock *block = new FileBlock();
+  int blockSector = firstBlock;
+
+  ClearIndex();
+  for (int i = 0; i < numSectors && blockSector != -1; i++) {
+    block->FetchFrom(blockSector);
+    IndexBlock(i, block);
+    if (blockSector == lastBlock) {
+      break;
     }
-    blockFetched = block->getNextBlock(); // get next block sector number
-    delete block;
+    blockSector = block->getNextBlock(); // get next block sector number
   }
+  delete block;
+  indexValid = TRUE;
+  DEBUG(dbgFile, "Indexed " << numIndexed << " file blocks");
+}
+
+//----------------------------------------------------------------------
+// FileHeader::IndexBlock
+// 	Copy the data sectors of a FileBlock into the sector index,
+//	growing the index if needed.
+//
+//	"n" is the position of the block in the chain
+//	"block" is the block itself
+//----------------------------------------------------------------------
+
+void
+FileHeader::IndexBlock(int n, FileBlock *block)
+{
+  if (n >= indexSize) {
+    int newSize = (indexSize == 0) ? 4 : indexSize * 2;
+    if (newSize <= n) {
+      newSize = n + 1;
+    }
+    int *newIndex = new int[newSize * NumInDirect];
+    if (sectorIndex != NULL) {
+      bcopy((char *)sectorIndex, (char *)newIndex,
+            indexSize * NumInDirect * sizeof(int));
+      delete [] sectorIndex;
+    }
+    sectorIndex = newIndex;
+    indexSize = newSize;
+  }
+
+  for (int i = 0; i < (int)NumInDirect; i++) {
+    sectorIndex[n * NumInDirect + i] = block->ByteToSector(i * SectorSize);
+  }
+  if (n >= numIndexed) {
+    numIndexed = n + 1;
+  }
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ClearIndex
+// 	Forget the sector index; it is rebuilt on the next ByteToSector.
+//	The memory is kept for reuse.
+//----------------------------------------------------------------------
+
+void
+FileHeader::ClearIndex()
+{
+  numIndexed = 0;
+  indexValid = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -376,6 +532,14 @@ FileHeader::FileHeader() {
   lastBlock = -1;
   firstBlock = -1;
 
+  sectorIndex = NULL;
+  numIndexed = 0;
+  indexSize = 0;
+  indexValid = FALSE;
+}
+
+FileHeader::~FileHeader() {
+  delete [] sectorIndex;
 }
 
 void 
@@ -29,9 +29,11 @@ class FileBlock {
 public:
   FileBlock(/*int index*/);
   ~FileBlock();
-  int Allocate(PersistentBitmap *bitMap, int fileSize);// Initialize a file header, 
+  int Allocate(PersistentBitmap *bitMap, int fileSize, int goal);
+          // Initialize a file block,
           //  including allocating space 
-          //  on disk for the file data
+          //  on disk for the file data,
+          //  as close to "goal" as we can
   void Deallocate(PersistentBitmap *bitMap);  // De-allocate this file's 
           //  data blocks
 
@@ -48,6 +50,7 @@ public:
   int FileLength();
   int getNextBlock();
   int Expand(PersistentBitmap *freeMap, int expendedSize);
+  int LastSector();   // last data sector allocated, -1 if none
 
 private:
   //int index;
@@ -71,13 +74,23 @@ private:
 // There is no constructor; rather the file header can be initialized
 // by allocating blocks for the file (if it is a new file), or by
 // reading it from disk.
+//
+// The data sectors are listed in a chain of FileBlocks on disk.  To
+// avoid walking the chain on every ByteToSector, the header keeps an
+// in-memory index of every data sector in the file.  The index lives
+// after the on-disk fields, so it is not read or written with the
+// header; it is rebuilt from the chain the first time it is needed
+// after FetchFrom, and kept up to date by Allocate.
 
 class FileHeader {
   public:
     FileHeader();
+    ~FileHeader();
     bool Allocate(PersistentBitmap *bitMap, int fileSize);// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
+    static int GrowthSectors(int fileSize);	// Most data sectors Allocate
+						//  can take for "fileSize" bytes
     void Deallocate(PersistentBitmap *bitMap);  // De-allocate this file's 
 						//  data blocks
 
@@ -105,6 +118,9 @@ class FileHeader {
     int getdirnum();
     void setdirnum(int n);
 
+    void BuildIndex();			// Walk the FileBlock chain and build
+					// the in-memory sector index
+
   private:
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
@@ -117,6 +133,19 @@ class FileHeader {
     int parentSector; // speedup searching
     int dataSectors[NumDirect]; 
     int dirnum;
+
+    // The rest is in memory only -- it must stay after the fields above,
+    // which fill exactly one sector on disk.
+    int *sectorIndex;			// Data sector of each sector of the
+					// file, NumInDirect per FileBlock
+    int numIndexed;			// # of FileBlocks in sectorIndex
+    int indexSize;			// # of FileBlocks sectorIndex can hold
+    bool indexValid;			// Does sectorIndex match the chain?
+
+    void IndexBlock(int n, FileBlock *block);
+					// Record the sectors of the n-th
+					// FileBlock in sectorIndex
+    void ClearIndex();			// Forget the sector index
 };
 
 #endif // FILEHDR_H
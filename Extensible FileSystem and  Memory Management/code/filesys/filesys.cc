@@ -51,6 +51,8 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "sectorcache.h"
+#include "main.h"
 #include <string>
 #include "synch.h"
 
@@ -67,6 +69,10 @@
 #define NumDirEntries 		10
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
 
+// Maximum number of (directory, name) pairs in the dentry cache; when
+// it fills up, it is simply emptied.
+#define DentryCacheSize 	1024
+
 static char *protectionName[] = { "- - x", "- w -", "- w x",
       "r - -", "r - x",
       "r w -", "r w x" };
@@ -88,9 +94,15 @@ FileSystem::FileSystem(bool format)
 { 
     DEBUG(dbgFile, "Initializing the file system.");
     currentDirSector = DirectorySector;
+    reservedSectors = 0;
+    dentryCache = new map<pair<int, string>, int>();
+    fullNameCache = new map<int, string>();
+    protectionCache = new map<int, int>();
+    kernel->fileSystem = this;	// OpenFile asks us for full path names,
+				// even for the files we open right here
 
     if (format) {
-        PersistentBitmap *freeMap = new PersistentBitmap(NumSectors);
+        freeMap = new PersistentBitmap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
 	FileHeader *mapHdr = new FileHeader;
 	FileHeader *dirHdr = new FileHeader;
@@ -146,7 +158,6 @@ FileSystem::FileSystem(bool format)
 	    freeMap->Print();
 	    directory->Print();
         }
-        delete freeMap; 
 	delete directory; 
 	delete mapHdr; 
 	delete dirHdr;
@@ -155,7 +166,178 @@ FileSystem::FileSystem(bool format)
     // the bitmap and directory; these are left open while Nachos is running
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+        freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystem::~FileSystem
+// 	Shut down the file system.  Write the free map and every dirty
+//	sector still in the sector cache to disk, then close the bitmap
+//	and directory files.
+//----------------------------------------------------------------------
+
+FileSystem::~FileSystem()
+{
+    DEBUG(dbgFile, "Shutting down the file system.");
+    Sync();
+    delete freeMap;
+    delete freeMapFile;
+    delete directoryFile;
+    delete dentryCache;
+    delete fullNameCache;
+    delete protectionCache;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Sync
+// 	Write the parts of the free map that changed since the last Sync
+//	back to the bitmap file, and flush the sector cache to disk.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Sync()
+{
+    DEBUG(dbgFile, "Syncing the file system.");
+    freeMap->WriteBack(freeMapFile);
+    kernel->sectorCache->Flush();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::SyncFreeMap
+// 	Write the sectors of the free map that changed since the last
+//	write back, and send them straight to disk rather than leaving
+//	them dirty in the sector cache.
+//
+//	Headers and directories can reach the disk whenever the sector
+//	cache evicts them, so the free map on disk is brought up to date
+//	at each sync point: after Create, Remove and MakeDir, and when
+//	an OpenFile allocates its delayed writes (Sync or close).  The
+//	sectors of one operation are written together.
+//----------------------------------------------------------------------
+
+void
+FileSystem::SyncFreeMap()
+{
+    freeMap->WriteBack(freeMapFile);
+    freeMapFile->Flush();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::getFreeMap
+// 	Return the free sector map, which stays in memory while Nachos
+//	is running.  Whoever changes it must not write it back itself,
+//	but call SyncFreeMap once the change is complete.
+//----------------------------------------------------------------------
+
+PersistentBitmap *
+FileSystem::getFreeMap()
+{
+    return freeMap;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Reserve
+// 	Set aside "numSectors" free sectors of the data area, so that a
+//	later Allocate of that much is sure to find room.  Nothing is
+//	marked in the free map; the sectors are only counted, and no one
+//	else may reserve or allocate them.  Return FALSE, reserving
+//	nothing, if there are not enough unreserved free sectors.
+//
+//	Used by delayed writes, which accept data before allocating it.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Reserve(int numSectors)
+{
+    if (freeMap->NumClearRange(NumInode + 2, NumSectors) - reservedSectors
+	< numSectors) {
+	DEBUG(dbgFile, "Cannot reserve " << numSectors << " sectors, " << reservedSectors << " already reserved");
+	return FALSE;
     }
+    reservedSectors += numSectors;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Unreserve
+// 	Return sectors set aside by Reserve, once they have been
+//	allocated or are no longer needed.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Unreserve(int numSectors)
+{
+    reservedSectors -= numSectors;
+    ASSERT(reservedSectors >= 0);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::LookupEntry
+// 	Return the sector of the file header of "name" in the directory
+//	whose header is at "dirSector", or -1 if there is no such entry.
+//	The answer, found or not, is remembered in the dentry cache, so
+//	the directory is only read the first time a name is looked up.
+//
+//	"dirSector" -- the directory to look in
+//	"name" -- the name to look for
+//----------------------------------------------------------------------
+
+int
+FileSystem::LookupEntry(int dirSector, char *name)
+{
+    if (dirSector < 0) {
+	return -1;
+    }
+
+    pair<int, string> key(dirSector, string(name, strnlen(name, FileNameMaxLen)));
+    map<pair<int, string>, int>::iterator entry = dentryCache->find(key);
+    if (entry != dentryCache->end()) {
+	DEBUG(dbgFile, "Dentry cache hit: " << name << " in " << dirSector);
+	return entry->second;
+    }
+
+    Directory *directory = new Directory(NumDirEntries);
+    OpenFile *dirFile = new OpenFile(dirSector);
+    directory->FetchFrom(dirFile);
+    int sector = directory->Find(name);
+    delete dirFile;
+    delete directory;
+
+    EnterDentry(dirSector, name, sector);
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::EnterDentry
+// 	Record in the dentry cache that "name" in directory "dirSector"
+//	now has its header at "sector" (-1 if it no longer exists).
+//----------------------------------------------------------------------
+
+void
+FileSystem::EnterDentry(int dirSector, char *name, int sector)
+{
+    if (dentryCache->size() >= DentryCacheSize) {
+	dentryCache->clear();
+    }
+    pair<int, string> key(dirSector, string(name, strnlen(name, FileNameMaxLen)));
+    (*dentryCache)[key] = sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ForgetSector
+// 	A file header sector is being freed or reused: drop its cached
+//	full name and protection bit, and every cached entry of the
+//	directory that lived there.
+//----------------------------------------------------------------------
+
+void
+FileSystem::ForgetSector(int sector)
+{
+    fullNameCache->erase(sector);
+    protectionCache->erase(sector);
+    dentryCache->erase(dentryCache->lower_bound(make_pair(sector, string())),
+		       dentryCache->lower_bound(make_pair(sector + 1, string())));
 }
 
 //----------------------------------------------------------------------
@@ -195,7 +377,6 @@ FileSystem::Create(char *name, int initialSize, int currentDirSector, int protec
   }
 
     Directory *directory;
-    PersistentBitmap *freeMap;
     FileHeader *hdr;
     OpenFile *openFile;
     int sector;
@@ -228,31 +409,40 @@ FileSystem::Create(char *name, int initialSize, int currentDirSector, int protec
       directory->Print();
     }
     else {	
-        freeMap = new PersistentBitmap(freeMapFile,NumSectors);
         sector = freeMap->FindAndSetRange(2, 2 + NumInode);	// find a sector to hold the file header (sector 2 - 47)
     	if (sector == -1) 		
             success = FALSE;		// no free block for file header 
       else if (!directory->Add(name, sector)) {
         cout << "Fail, the current directory is full! \n";
+        freeMap->Clear(sector);
         success = FALSE;	// no space in directory
       }
 	else {
+    	    int needed = FileHeader::GrowthSectors(initialSize);
+
     	    hdr = new FileHeader;
-	    if (!hdr->Allocate(freeMap, initialSize))
+	    if (!Reserve(needed)) {	// leave delayed writes their space
+            	freeMap->Clear(sector);
+            	success = FALSE;	// no space on disk for data
+	    } else if (!hdr->Allocate(freeMap, initialSize)) {
+            	Unreserve(needed);
+            	freeMap->Clear(sector);
             	success = FALSE;	// no space on disk for data
-	    else {	
+	    } else {	
+            	Unreserve(needed);
 	    	success = TRUE;
 
         hdr->setParentSector(parentSector); // save parent sector
         hdr->setProtectionBit(protection); // set protection bit
 		// everthing worked, flush all changes back to disk
+    	    	SyncFreeMap();
     	    	hdr->WriteBack(sector); 		
     	    	directory->WriteBack(openFile);
-    	    	freeMap->WriteBack(freeMapFile);
+        ForgetSector(sector); // may have been a file removed before
+        EnterDentry(parentSector, name, sector);
 	    }
             delete hdr;
 	}
-        delete freeMap;
     }
     delete directory;
     delete openFile;
@@ -272,7 +462,6 @@ FileSystem::Create(char *name, int initialSize, int currentDirSector, int protec
 OpenFile *
 FileSystem::Open(char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
     int sector;
 
@@ -283,17 +472,11 @@ FileSystem::Open(char *name)
       DEBUG(dbgFile, "cannot find sector " << sector);
     }
 
-    openFile = new OpenFile(sector); // fetch dir file
-    directory->FetchFrom(openFile);
-    delete openFile;
-    openFile = NULL;
-
-    sector = directory->Find(name);
+    sector = LookupEntry(sector, name);
     if (sector > -1) { // find the file
       openFile = new OpenFile(sector);
     }
 
-    delete directory;
     return openFile;
 
  // // single dir
@@ -323,7 +506,6 @@ bool
 FileSystem::Remove(char *name) // make sure no process access to the file any more
 { 
     Directory *directory;
-    PersistentBitmap *freeMap;
     FileHeader *fileHdr;
     int sector;
     
@@ -341,17 +523,16 @@ FileSystem::Remove(char *name) // make sure no process access to the file any mo
     fileHdr = new FileHeader;
     fileHdr->FetchFrom(sector);
 
-    freeMap = new PersistentBitmap(freeMapFile,NumSectors);
-
     fileHdr->Deallocate(freeMap);  		// remove data blocks
     freeMap->Clear(sector);			// remove header block
     directory->Remove(name);
 
-    freeMap->WriteBack(freeMapFile);		// flush to disk
     directory->WriteBack(openFile);        // flush to disk
+    SyncFreeMap();
+    EnterDentry(dirSector, name, -1);
+    ForgetSector(sector);
     delete fileHdr;
     delete directory;
-    delete freeMap;
     delete openFile;
     return TRUE;
 } 
@@ -400,7 +581,6 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    PersistentBitmap *freeMap = new PersistentBitmap(freeMapFile,NumSectors);
     Directory *directory = new Directory(NumDirEntries);
 
     printf("Bit map file header:\n");
@@ -424,7 +604,6 @@ FileSystem::Print()
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
     delete directory;
     delete openFile;
 } 
@@ -500,30 +679,41 @@ FileSystem::MakeDir(char **name, int currentDir) { // name cannot contains "/"
     success = FALSE; // dir already in directory
   }
   else {
-    PersistentBitmap *freeMap = new PersistentBitmap(freeMapFile, NumSectors);
     int hdrSector = freeMap->FindAndSetRange(2, 2 + NumInode);
     if (hdrSector == -1) {
       success = FALSE;
     }
     else if (directory->Add(*name, hdrSector) == FALSE) {
       cout << "Fail, the current directory is full!\n";
+      freeMap->Clear(hdrSector);
       success = FALSE;
     }
     else {
+      int needed = FileHeader::GrowthSectors(DirectoryFileSize);
+
       dirHdr = new FileHeader();
-      if (dirHdr->Allocate(freeMap, DirectoryFileSize) == FALSE) {
+      if (Reserve(needed) == FALSE) { // leave delayed writes their space
+        freeMap->Clear(hdrSector);
+        success = FALSE;
+      }
+      else if (dirHdr->Allocate(freeMap, DirectoryFileSize) == FALSE) {
+        Unreserve(needed);
+        freeMap->Clear(hdrSector);
         success = FALSE;
       }
       else {
+        Unreserve(needed);
         success = TRUE;
         dirHdr->setProtectionBit(6); // default: r w -
         dirHdr->setParentSector(pSector); // record parent sector
         dirHdr->setDir(); // mark as dir
         dirHdr->setdirnum(NumDirEntries);
+        SyncFreeMap();
         dirHdr->WriteBack(hdrSector); // save hdr
         directory->WriteBack(openFile); // save parent dir
+        ForgetSector(hdrSector);
+        EnterDentry(pSector, *name, hdrSector);
 
-        freeMap->WriteBack(freeMapFile);// save free map;
         Directory *newDir = new Directory(NumDirEntries);
         OpenFile *newDirFile = new OpenFile(hdrSector);
 
@@ -541,7 +731,6 @@ FileSystem::MakeDir(char **name, int currentDir) { // name cannot contains "/"
       }
       delete dirHdr;
     }
-    delete freeMap;
   }
 
   delete directory;
@@ -579,15 +768,8 @@ int FileSystem::processPath(char **name, int sector) {
       dir = ".";
     }
 
-    Directory *dirObj = new Directory(NumDirEntries);
-    OpenFile *dirFile = new OpenFile(sector);
-    dirObj->FetchFrom(dirFile);
-    if (dirObj->Find((char*)dir.c_str()) != -1) { // can find the dir
-      sector = dirObj->Find((char*)dir.c_str());  // get sector of the dir
-      delete dirObj;
-      delete dirFile;
-    }
-    else { // cannot find
+    sector = LookupEntry(sector, (char*)dir.c_str()); // get sector of the dir
+    if (sector == -1) { // cannot find
       return -1;
     }
   }
@@ -615,27 +797,17 @@ FileSystem::getFullName(char *name, int sec) { // will change "name"
     return NULL;
   }
 
-  OpenFile* openFile = new OpenFile(sector);
-  Directory* directory = new Directory(NumDirEntries);
-  directory->FetchFrom(openFile);
-  sector = directory->Find(name);
+  sector = LookupEntry(sector, name);
   if (sector == -1) {
     cout << "Error filename! \n";
     return NULL;
   }
 
-  char *result = getFullName(sector); // dir path
-  delete openFile;
-  delete directory;
-  return result;
+  return getFullName(sector); // dir path
 }
 
 int 
 FileSystem::getProtectionBit(char *name, int sec) { // will not change name
-  FileHeader *hdr = new FileHeader();
-  Directory *dir = new Directory(NumDirEntries);
-  OpenFile *parentFile;
-
   char* temp = new char[strlen(name) + 1];
   memcpy(temp, name, strlen(name) + 1);
 
@@ -645,19 +817,23 @@ FileSystem::getProtectionBit(char *name, int sec) { // will not change name
     sector = DirectorySector;
   }
 
-  parentFile = new OpenFile(sector);
-  dir->FetchFrom(parentFile);
-  targetSector = dir->Find(temp);
+  targetSector = LookupEntry(sector, temp);
+  delete [] temp;
 
   if (targetSector == -1) {
     targetSector = DirectorySector; // treat as root
   }
-  delete parentFile;
 
+  map<int, int>::iterator cached = protectionCache->find(targetSector);
+  if (cached != protectionCache->end()) {
+    return cached->second;
+  }
+
+  FileHeader *hdr = new FileHeader();
   hdr->FetchFrom(targetSector);
   int result = hdr->getProtectionBit(); // dir path
   delete hdr;
-  delete dir;
+  (*protectionCache)[targetSector] = result;
   return result;
 }
 
@@ -732,6 +908,7 @@ FileSystem::setProtectionBit(char* fullPath, int bit) {
   hdr->FetchFrom(targetSector);
   hdr->setProtectionBit(bit); // dir path
   hdr->WriteBack(targetSector);
+  protectionCache->erase(targetSector);
   delete openfile;
   delete directory;
   delete parentHdr;
@@ -744,12 +921,27 @@ FileSystem::getFullName(int sector) {
   string path = "";
   string name;
   char *filename = new char[100];
+  int target = sector;
 
   if (sector < 1 || sector > 1029) {
     return "invalid";
   }
 
   while (sector != 1029) {
+    map<int, string>::iterator cached = fullNameCache->find(sector);
+    if (cached != fullNameCache->end()) { // rest of the path is known
+      if (path == "") {
+        path = cached->second;
+      }
+      else if (cached->second == "/") {
+        path = "/" + path;
+      }
+      else {
+        path = cached->second + "/" + path;
+      }
+      break;
+    }
+
     FileHeader *currentHdr = new FileHeader();
     currentHdr->FetchFrom(sector);
     int parentSector = currentHdr->getParentSector();
@@ -779,6 +971,7 @@ FileSystem::getFullName(int sector) {
     delete currentHdr;
   }
 
+  (*fullNameCache)[target] = path;
   strcpy(filename, path.c_str());
   return filename; // sector of dir
 }
@@ -888,6 +1081,9 @@ FileSystem::moveDir(char* from, char *to) {
   toDirectory->Add(toDir, targetSector);
   fromDirectory->WriteBack(fromOpenfile); // update
   toDirectory->WriteBack(toOpenfile);
+  EnterDentry(fromPSector, fromDir, -1);
+  EnterDentry(toPSector, toDir, targetSector);
+  fullNameCache->clear(); // everything below it has moved too
 
   if (hdr->isDir() == TRUE) { // if the path is dir path
     OpenFile *openfile = new OpenFile(targetSector);
@@ -898,6 +1094,7 @@ FileSystem::moveDir(char* from, char *to) {
       dirFile->Remove(".."); 
       dirFile->Add("..", toPSector);
       dirFile->WriteBack(openfile); // save
+      EnterDentry(targetSector, "..", toPSector);
     }
 
     delete openfile;
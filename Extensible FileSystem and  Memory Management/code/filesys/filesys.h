@@ -36,7 +36,9 @@
 #include "copyright.h"
 #include "sysdep.h"
 #include "openfile.h"
+#include "pbitmap.h"
 #include <map>
+#include <string>
 
 #ifdef FILESYS_STUB 		// Temporarily implement file system calls as 
 				// calls to UNIX, until the real file system
@@ -75,7 +77,23 @@ class FileSystem {
 					// the disk, so initialize the directory
     					// and the bitmap of free blocks.
 
-    bool Create(char *name, int initialSize, int currentDirSector, int protection);  	
+    ~FileSystem();			// Close the bitmap and directory
+					// files, and flush the sector cache
+
+    void Sync();			// Write the free map and the sector
+					// cache to disk
+
+    void SyncFreeMap();			// Write the changed parts of the
+					// free map through to disk
+
+    PersistentBitmap *getFreeMap();	// The resident free sector map
+
+    bool Reserve(int numSectors);	// Set aside free data sectors for a
+					// later Allocate; FALSE if there are
+					// not that many left
+    void Unreserve(int numSectors);	// Give reserved sectors back
+
+    bool Create(char *name, int initialSize, int currentDirSector, int protection);
 					// Create a file (UNIX creat)
 
     OpenFile* Open(char *name); 	// Open a file (UNIX open)
@@ -127,7 +145,27 @@ class FileSystem {
 					// represented as a file
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   PersistentBitmap *freeMap;		// Free sectors, kept in memory;
+					// written back by Sync
    int currentDirSector;
+   int reservedSectors;			// Free sectors promised to delayed
+					// writes (see OpenFile::Sync)
+
+   // Caches for path resolution, so that a path that was resolved
+   // before does not need its directories read again.
+   map<pair<int, string>, int> *dentryCache;
+					// (directory sector, name) -> sector
+					// of the entry, -1 if it is not there
+   map<int, string> *fullNameCache;	// sector -> full path name
+   map<int, int> *protectionCache;	// sector -> protection bit
+
+   int LookupEntry(int dirSector, char *name);
+					// Sector of "name" in a directory,
+					// through the dentry cache
+   void EnterDentry(int dirSector, char *name, int sector);
+					// Record where "name" is now
+   void ForgetSector(int sector);	// Drop everything cached about
+					// the file or dir at "sector"
 
 };
 
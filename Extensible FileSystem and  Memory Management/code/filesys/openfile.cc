@@ -17,6 +17,7 @@
 #include "filehdr.h"
 #include "openfile.h"
 #include "synchdisk.h"
+#include "sectorcache.h"
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
@@ -30,18 +31,34 @@ OpenFile::OpenFile(int sector)
 { 
     hdr = new FileHeader();
     hdr->FetchFrom(sector);
+    hdr->BuildIndex();			// so ByteToSector never hits the disk
     seekPosition = 0;
     hdrSector = sector;
+    seqPosition = -1;
+    readAhead = 0;
+    prefetchedTo = 0;
+    pending = NULL;
+    pendingBytes = pendingSize = 0;
+    reservedSectors = 0;
     path = kernel->fileSystem->getFullName(sector);
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
+//	Data appended to the file that is still in memory is written
+//	out first.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
+  if (!Sync()) {			// allocate and write delayed data
+    cerr << "No room on disk for the last " << pendingBytes << " bytes written to " << path << "\n";
+  }
+  if (reservedSectors > 0) {
+    kernel->fileSystem->Unreserve(reservedSectors);
+  }
+  delete [] pending;
   delete hdr;
 }
 
@@ -94,6 +111,54 @@ OpenFile::Write(char *into, int numBytes)
    return result;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Called after each read.  If the read started where the last one
+//	ended, the file is being read sequentially: grow the read-ahead
+//	window (1, 2, 4, ... up to MaxReadAhead sectors), and ask the
+//	sector cache to fetch the sectors after this read in the
+//	background.  Any other read resets the window.
+//
+//	Sectors already asked for by an earlier call are not asked for
+//	again, so a steady sequential reader only queues the sectors at
+//	the leading edge of the window.
+//
+//	"position" -- the offset of the first byte read
+//	"numBytes" -- the number of bytes read
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int position, int numBytes)
+{
+    int lastSector = divRoundDown(position + numBytes - 1, SectorSize);
+    int fileSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int i, from, to;
+
+    if (position == seqPosition) {
+	readAhead = (readAhead == 0) ? 1 : min(2 * readAhead, MaxReadAhead);
+    } else {
+	readAhead = 0;
+	prefetchedTo = 0;
+    }
+    seqPosition = position + numBytes;
+    if (readAhead == 0) {
+	return;
+    }
+
+    from = max(lastSector + 1, prefetchedTo);
+    to = min(lastSector + readAhead, fileSectors - 1);
+    for (i = from; i <= to; i++) {
+	int sector = hdr->ByteToSector(i * SectorSize);
+
+	if (sector != -1) {
+	    kernel->sectorCache->Prefetch(sector);
+	}
+    }
+    if (to >= from) {
+	prefetchedTo = to + 1;
+    }
+}
+
 //----------------------------------------------------------------------
 // OpenFile::ReadAt/WriteAt
 // 	Read/write a portion of a file, starting at "position".
@@ -127,63 +192,103 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
 
     // -- enter critical region
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
+    int length = fileLength + pendingBytes;	// including delayed data
+    int i, run, firstSector, lastSector, numSectors, diskBytes;
     char *buf;
 
-    if ((numBytes <= 0) || (position >= fileLength)) {
+    if ((numBytes <= 0) || (position >= length)) {
       //leaveReadRegion();
       return 0; 				// check request
     }
-    if ((position + numBytes) > fileLength)		
-	numBytes = fileLength - position;
-    DEBUG(dbgFile, "Reading " << numBytes << " bytes at " << position << " from file of length " << fileLength);
+    if ((position + numBytes) > length)		
+	numBytes = length - position;
+    DEBUG(dbgFile, "Reading " << numBytes << " bytes at " << position << " from file of length " << length);
+
+    // anything past the allocated part of the file is still in memory
+    diskBytes = numBytes;
+    if ((position + numBytes) > fileLength) {
+	int start = max(position, fileLength);
+
+	bcopy(&pending[start - fileLength], &into[start - position],
+	      position + numBytes - start);
+	diskBytes = start - position;
+	if (diskBytes == 0) {
+	    return numBytes;
+	}
+    }
 
     firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
+    lastSector = divRoundDown(position + diskBytes - 1, SectorSize);
     numSectors = 1 + lastSector - firstSector;
 
-    // read in all the full and partial sectors that we need
+    // read in all the full and partial sectors that we need, one
+    // request for each run of sectors that are contiguous on disk
     buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
+    for (i = firstSector; i <= lastSector; i += run) {
+	int sector = hdr->ByteToSector(i * SectorSize);
+
+	run = 1;
+	if (sector < 0) {		// unassigned, leave it alone
+	    continue;
+	}
+	while (i + run <= lastSector
+	       && hdr->ByteToSector((i + run) * SectorSize) == sector + run) {
+	    run++;
+	}
+        kernel->sectorCache->ReadSectors(sector, 
+					&buf[(i - firstSector) * SectorSize], run);
+    }
 
     // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
+    bcopy(&buf[position - (firstSector * SectorSize)], into, diskBytes);
     //leaveReadRegion();
     //  -- leave critical regoin --
 
     delete [] buf;
+    ReadAhead(position, diskBytes);
     return numBytes;
 }
 
 int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
-    if (position + numBytes > hdr->FileLength()) {
-    OpenFile *mapFile = new OpenFile(0);
-    PersistentBitmap *freeMap = new PersistentBitmap(mapFile, NumSectors);
-    hdr->Allocate(freeMap, position + numBytes - hdr->FileLength() +1);
-    hdr->WriteBack(hdrSector);
-    freeMap->WriteBack(mapFile);
-    delete freeMap;
-    delete mapFile;
-    } 
-
     //enterWriteRegion();
     // -- enter critical region 
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
+    int i, firstSector, lastSector, numSectors, delayed = 0;
     bool firstAligned, lastAligned;
     char *buf;
 
-
-    if ((numBytes <= 0) || (position >= fileLength)) {
+    if (numBytes <= 0) {
       //leaveWriteRegion();
       return 0;				// check request
     }
-    if ((position + numBytes) > fileLength)
-	numBytes = fileLength - position;
+
+    // A write that extends the file leaves one spare byte at the end,
+    // which append mode then writes over.  Space for the new part is
+    // not allocated yet: it is kept in memory until Sync.  If the disk
+    // could not hold it, only the part that fits is written.
+    if ((position + numBytes) > fileLength + pendingBytes
+	&& !GrowPending(position + numBytes + 1 - fileLength)) {
+	numBytes = fileLength + pendingBytes - position;
+	if (numBytes <= 0) {
+	    return 0;			// disk full
+	}
+    }
+    if ((position + numBytes) > fileLength) {
+	int start = max(position, fileLength);
+
+	delayed = position + numBytes - start;
+	bcopy(&from[start - position], &pending[start - fileLength], delayed);
+	numBytes -= delayed;
+	DEBUG(dbgFile, "Delaying " << delayed << " bytes at " << start << ", " << pendingBytes << " bytes pending");
+    }
+    if (numBytes == 0) {
+	if (pendingBytes >= MaxPendingBytes) {	// too much held in memory
+	    Sync();
+	}
+	return delayed;
+    }
     DEBUG(dbgFile, "Writing " << numBytes << " bytes at " << position << " from file of length " << fileLength);
 
     firstSector = divRoundDown(position, SectorSize);
@@ -207,12 +312,124 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
 
 // write modified sectors back
     for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
+        kernel->sectorCache->WriteSector(hdr->ByteToSector(i * SectorSize), 
 					&buf[(i - firstSector) * SectorSize]);
     //leaveWriteRegion();
     // -- leave critical region --
     delete [] buf;
-    return numBytes;
+    if (pendingBytes >= MaxPendingBytes) {	// too much held in memory
+	Sync();
+    }
+    return numBytes + delayed;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::GrowPending
+// 	Extend the in-memory tail of the file to "numBytes" bytes past
+//	the allocated length.  The new bytes read as zero.
+//
+//	Enough free sectors for the whole tail are reserved first, so
+//	that Sync can always allocate it.  Return FALSE, leaving the
+//	tail as it was, if the disk does not have them.
+//
+//	"numBytes" -- the new size of the delayed tail
+//----------------------------------------------------------------------
+
+bool
+OpenFile::GrowPending(int numBytes)
+{
+    int needed = FileHeader::GrowthSectors(numBytes);
+
+    if (needed > reservedSectors) {
+	if (!kernel->fileSystem->Reserve(needed - reservedSectors)) {
+	    return FALSE;
+	}
+	reservedSectors = needed;
+    }
+    if (numBytes > pendingSize) {
+	int newSize = max(numBytes, 2 * pendingSize);
+	char *newPending = new char[newSize];
+
+	if (pendingBytes > 0) {
+	    bcopy(pending, newPending, pendingBytes);
+	}
+	delete [] pending;
+	pending = newPending;
+	pendingSize = newSize;
+    }
+    bzero(&pending[pendingBytes], numBytes - pendingBytes);
+    pendingBytes = numBytes;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Sync
+// 	Allocate disk space for the data that has been appended to the
+//	file but is still held in memory, and write it out.  All of it
+//	is allocated at once, from the file system's resident free map,
+//	so the file header is written once per batch rather than once per
+//	write, and the new sectors can be placed next to each other.
+//
+//	Called when the file is closed, and whenever too much data is
+//	waiting.
+//
+//	The space was reserved as the tail grew, so this should not
+//	fail; if it does, the tail is kept in memory, still readable
+//	through this OpenFile, and FALSE is returned.
+//----------------------------------------------------------------------
+
+bool
+OpenFile::Sync()
+{
+    int fileLength = hdr->FileLength();
+    int numBytes = pendingBytes;
+
+    if (numBytes == 0) {
+	return TRUE;
+    }
+    DEBUG(dbgFile, "Allocating " << numBytes << " delayed bytes at " << fileLength);
+
+    if (!hdr->Allocate(kernel->fileSystem->getFreeMap(), numBytes)) {
+	DEBUG(dbgFile, "Not enough space for delayed write");
+	return FALSE;
+    }
+    kernel->fileSystem->SyncFreeMap();	// before the header can reach disk
+    pendingBytes = 0;
+    kernel->fileSystem->Unreserve(reservedSectors);	// now allocated
+    reservedSectors = 0;
+    hdr->WriteBack(hdrSector);
+
+    WriteAt(pending, numBytes, fileLength);	// the file now covers it
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Flush
+// 	Write the sectors of this file that are dirty in the sector cache
+//	to disk now, rather than whenever the cache evicts them.  Each
+//	run of contiguous sectors is flushed at once.  Data still in
+//	the delayed tail is not touched; Sync it first.
+//----------------------------------------------------------------------
+
+void
+OpenFile::Flush()
+{
+    int numSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int i, run;
+
+    for (i = 0; i < numSectors; i += run) {
+	int sector = hdr->ByteToSector(i * SectorSize);
+
+	run = 1;
+	if (sector < 0) {		// unassigned
+	    continue;
+	}
+	while (i + run < numSectors
+	       && hdr->ByteToSector((i + run) * SectorSize) == sector + run) {
+	    run++;
+	}
+	kernel->sectorCache->Flush(sector, sector + run);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -223,7 +440,7 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
 int
 OpenFile::Length() 
 { 
-    return hdr->FileLength(); 
+    return hdr->FileLength() + pendingBytes; 
 }
 
 char* 
@@ -332,4 +549,9 @@ int
 OpenFile::getSize() {
   return hdr->getdirnum();
 }
+
+int
+OpenFile::getHdrSector() {
+  return hdrSector;
+}
 #endif //FILESYS_STUB
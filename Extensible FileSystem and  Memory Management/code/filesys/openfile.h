@@ -53,6 +53,9 @@ class OpenFile {
 		}
 
     int Length() { Lseek(file, 0, 2); return Tell(file); }
+
+    bool Sync() { return TRUE; }	// UNIX writes are not delayed
+    void Flush() {}
     
   private:
     int file;
@@ -62,6 +65,11 @@ class OpenFile {
 #else // FILESYS
 class FileHeader;
 
+#define MaxReadAhead	16	// largest read-ahead window, in sectors
+#define MaxPendingBytes	(16 * SectorSize)
+				// appended data held in memory before
+				// it is allocated and written out
+
 class OpenFile {
   public:
     OpenFile(int sector);		// Open a file whose header is located
@@ -87,6 +95,13 @@ class OpenFile {
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
 
+    bool Sync();			// Allocate space for appended data
+					// still in memory, and write it out;
+					// FALSE if the disk is full
+
+    void Flush();			// Write this file's sectors held
+					// dirty in the sector cache to disk
+
     char* getFullName();
 
     int getOpenfileId();
@@ -109,6 +124,9 @@ class OpenFile {
 
     int getSize();
 
+    int getHdrSector();			// Sector of the file header; names
+					// the file as long as it is open
+
   private:
     FileHeader *hdr;			// Header for this file 
     int seekPosition;			// Current position within the file
@@ -117,6 +135,28 @@ class OpenFile {
     int openfileId;
     bool release;
     int mode;
+
+    // Sequential read-ahead state
+    int seqPosition;			// Where the next read starts, if
+					// the file is read sequentially
+    int readAhead;			// Current read-ahead window, in
+					// sectors; 0 until a pattern is seen
+    int prefetchedTo;			// First file sector not yet asked
+					// for by read-ahead
+
+    void ReadAhead(int position, int numBytes);
+					// Prefetch the sectors following a
+					// read, if the reads are sequential
+
+    // Delayed allocation: bytes written past the allocated end of the
+    // file are kept here until Sync
+    char *pending;			// Data past hdr->FileLength()
+    int pendingBytes;			// How much of it there is
+    int pendingSize;			// Size of the "pending" buffer
+    int reservedSectors;		// Disk space set aside for it
+
+    bool GrowPending(int numBytes);	// Extend the delayed tail, if the
+					// disk has room for it
 };
 
 #endif // FILESYS
@@ -8,6 +8,7 @@
 
 #include "copyright.h"
 #include "pbitmap.h"
+#include "disk.h"
 
 //----------------------------------------------------------------------
 // PersistentBitmap::PersistentBitmap(int)
@@ -21,6 +22,8 @@
 
 PersistentBitmap::PersistentBitmap(int numItems):Bitmap(numItems) 
 { 
+    onDisk = new unsigned int[numWords];
+    onDiskValid = FALSE;		// the disk copy is unknown
 }
 
 //----------------------------------------------------------------------
@@ -40,7 +43,8 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems
     // map has already been initialized by the BitMap constructor,
     // but we will just overwrite that with the contents of the
     // map found in the file
-    file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    onDisk = new unsigned int[numWords];
+    FetchFrom(file);
 }
 
 //----------------------------------------------------------------------
@@ -50,6 +54,7 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems
 
 PersistentBitmap::~PersistentBitmap()
 { 
+    delete [] onDisk;
 }
 
 //----------------------------------------------------------------------
@@ -63,11 +68,15 @@ void
 PersistentBitmap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    bcopy(map, onDisk, numWords * sizeof(unsigned));
+    onDiskValid = TRUE;
 }
 
 //----------------------------------------------------------------------
 // PersistentBitmap::WriteBack
 // 	Store the contents of a persistent bitmap to a Nachos file.
+//	Only the sectors of the file whose bits have changed since the
+//	last FetchFrom or WriteBack are written.
 //
 //	"file" is the place to write the bitmap to
 //----------------------------------------------------------------------
@@ -75,5 +84,87 @@ PersistentBitmap::FetchFrom(OpenFile *file)
 void
 PersistentBitmap::WriteBack(OpenFile *file)
 {
-   file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+    int wordsPerSector = SectorSize / sizeof(unsigned);
+
+    for (int first = 0; first < numWords; first += wordsPerSector) {
+	int count = min(wordsPerSector, numWords - first);
+	int numBytes = count * sizeof(unsigned);
+
+	if (onDiskValid && !memcmp(&map[first], &onDisk[first], numBytes)) {
+	    continue;			// this sector is unchanged
+	}
+	file->WriteAt((char *)&map[first], numBytes, first * sizeof(unsigned));
+	bcopy(&map[first], &onDisk[first], numBytes);
+    }
+    onDiskValid = TRUE;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::AllocateNear
+// 	Find a clear bit as close as possible to "goal", mark it and
+//	return it.  The bits are taken to be disk sectors: we try "goal"
+//	itself, then the following sectors on the same track (in the
+//	order they rotate under the head), then the tracks 1, 2, ...
+//	away from it, so that the head has to move as little as possible.
+//	If no bits in [from, to) are clear, return -1.
+//
+//	"goal" is the sector we would like to get
+//	"from", "to" bound the sectors we may hand out: [from, to)
+//----------------------------------------------------------------------
+
+int
+PersistentBitmap::AllocateNear(int goal, int from, int to)
+{
+    if (goal < from || goal >= to) {
+	goal = from;
+    }
+    int goalTrack = goal / SectorsPerTrack;
+
+    for (int distance = 0; distance < NumTracks; distance++) {
+	for (int side = 0; side < 2; side++) {
+	    int track = (side == 0) ? goalTrack + distance
+				    : goalTrack - distance;
+	    if (track < 0 || track >= NumTracks || 
+			(side == 1 && distance == 0)) {
+		continue;
+	    }
+	    for (int i = 0; i < SectorsPerTrack; i++) {
+		int sector = track * SectorsPerTrack 
+				+ (goal + i) % SectorsPerTrack;
+		if (sector >= from && sector < to && !Test(sector)) {
+		    Mark(sector);
+		    return sector;
+		}
+	    }
+	}
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::FindRunNear
+// 	Find "count" contiguous clear bits in [from, to), looking first
+//	at or after "goal" and then wrapping around to "from".  The bits
+//	are not marked.  Return the first bit of the run, or -1 if there
+//	is no such run.
+//
+//	"goal" is where we would like the run to start
+//	"count" is the length of the run
+//	"from", "to" bound the search: [from, to)
+//----------------------------------------------------------------------
+
+int
+PersistentBitmap::FindRunNear(int goal, int count, int from, int to)
+{
+    int start;
+
+    if (goal < from || goal >= to) {
+	goal = from;
+    }
+    start = FindContiguousRange(count, goal, to);
+    if (start == -1) {
+	start = FindContiguousRange(count, from, min(goal + count - 1, to));
+    }
+    return start;
 }
+
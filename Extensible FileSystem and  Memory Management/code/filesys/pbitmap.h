@@ -20,6 +20,14 @@
 // The following class defines a persistent bitmap.  It inherits all
 // the behavior of a bitmap (see bitmap.h), adding the ability to
 // be read from and stored to the disk.
+//
+// It also knows the disk geometry, so that file data can be placed
+// to keep seeks short: AllocateNear prefers the wanted sector, then
+// the rest of its track, then the nearest tracks; FindRunNear looks
+// for a contiguous run of free sectors at or after a goal sector.
+//
+// It remembers what it last read from, or wrote to, the disk, so that
+// WriteBack only writes the sectors of the bitmap file that changed.
 
 class PersistentBitmap : public Bitmap {
   public:
@@ -29,7 +37,21 @@ class PersistentBitmap : public Bitmap {
     ~PersistentBitmap(); 			// deallocate bitmap
 
     void FetchFrom(OpenFile *file);     // read bitmap from the disk
-    void WriteBack(OpenFile *file); 	// write bitmap contents to disk 
+    void WriteBack(OpenFile *file); 	// write changed parts of the
+					// bitmap to disk
+
+    int AllocateNear(int goal, int from, int to);
+					// allocate the free sector in
+					// [from, to) closest to "goal"
+    int FindRunNear(int goal, int count, int from, int to);
+					// find "count" contiguous free
+					// sectors in [from, to), preferring
+					// ones at or after "goal"
+
+  private:
+    unsigned int *onDisk;		// the bits as last read/written,
+					// to find the sectors that changed
+    bool onDiskValid;			// is "onDisk" known?
 };
 
 #endif // PBITMAP_H
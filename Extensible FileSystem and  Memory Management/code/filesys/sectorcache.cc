@@ -0,0 +1,477 @@
+// sectorcache.cc
+//	Routines to cache disk sectors in memory.  The file system reads
+//	and writes sectors through the cache instead of going straight
+//	to the synchronous disk.
+//
+//	The cache is write-back: a write only modifies the cached copy
+//	and marks it dirty.  Dirty sectors reach the disk when their slot
+//	is reused for another sector, or when Flush is called.
+//
+//	Slots are replaced using the CLOCK algorithm: each slot has a
+//	"referenced" bit that is set on every access, and the clock hand
+//	clears it as it sweeps by.  The first slot found with the bit
+//	already clear is the victim.
+//
+//	Disk I/O is done without holding the cache lock, so that other
+//	threads can keep hitting in the cache in the meantime.  A slot
+//	with I/O in progress is marked "busy"; anyone who needs it
+//	waits on the "slotFree" condition until the I/O is done.
+//
+//	Read-ahead is done by a separate "read-ahead" thread, which reads
+//	the sectors queued by Prefetch into the cache while the thread
+//	that asked for them goes on running.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "sectorcache.h"
+#include "synchdisk.h"
+#include "main.h"
+#include "thread.h"
+
+//----------------------------------------------------------------------
+// SectorCache::SectorCache
+// 	Initialize an empty cache of disk sectors.
+//
+//	"disk" -- the synchronous disk that holds the real data
+//	"size" -- the number of sectors the cache can hold
+//----------------------------------------------------------------------
+
+SectorCache::SectorCache(SynchDisk *disk, int size)
+{
+    ASSERT(size > 0);
+
+    synchDisk = disk;
+    numEntries = size;
+    entries = new CacheEntry[numEntries];
+    for (int i = 0; i < numEntries; i++) {
+	entries[i].sector = -1;
+	entries[i].dirty = FALSE;
+	entries[i].busy = FALSE;
+	entries[i].referenced = FALSE;
+	entries[i].prefetched = FALSE;
+    }
+    slotOf = new int[NumSectors];
+    for (int i = 0; i < NumSectors; i++) {
+	slotOf[i] = -1;
+    }
+    hand = 0;
+    lock = new Lock("sector cache lock");
+    slotFree = new Condition("sector cache slot free");
+    readAheadList = new SynchList<int>;
+
+    Thread *t = new Thread("read-ahead");
+    t->Fork((VoidFunctionPtr) ReadAheadDaemon, (void *) this);
+}
+
+//----------------------------------------------------------------------
+// SectorCache::~SectorCache
+// 	Write back any dirty sectors, then de-allocate the cache.
+//----------------------------------------------------------------------
+
+SectorCache::~SectorCache()
+{
+    Flush();
+    delete readAheadList;
+    delete slotFree;
+    delete lock;
+    delete [] slotOf;
+    delete [] entries;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::ReadSector
+// 	Read the contents of a disk sector into a buffer, from the
+//	cache if possible.  Return only after the data is in "data".
+//
+//	"sectorNumber" -- the disk sector to read
+//	"data" -- the buffer to hold the contents of the disk sector
+//----------------------------------------------------------------------
+
+void
+SectorCache::ReadSector(int sectorNumber, char* data)
+{
+    if (sectorNumber < 0) {		// unassigned sector, nothing to read
+	DEBUG(dbgFile, "Cache: unassigned sector " << sectorNumber);
+	return;
+    }
+    ReadSectors(sectorNumber, data, 1);
+}
+
+//----------------------------------------------------------------------
+// SectorCache::ReadSectors
+// 	Read a run of consecutive disk sectors into a buffer.  Sectors
+//	that are cached are copied from the cache; each stretch of
+//	sectors that are not is read from disk with a single request,
+//	straight into "data", and then copied into the cache.
+//
+//	Slots for a stretch are allocated, and marked busy, before the
+//	disk is read, so nobody else can cache (or write) those sectors
+//	while the read is in progress.
+//
+//	"sectorNumber" -- the first disk sector to read
+//	"data" -- the buffer, numSectors * SectorSize bytes long
+//	"numSectors" -- the number of consecutive sectors to read
+//----------------------------------------------------------------------
+
+void
+SectorCache::ReadSectors(int sectorNumber, char* data, int numSectors)
+{
+    int maxRun = max(numEntries / 2, 1);	// leave slots for others
+    CacheEntry **run = new CacheEntry *[min(numSectors, maxRun)];
+    CacheEntry *entry;
+    int i = 0, n;
+    bool cached;
+
+    ASSERT((sectorNumber >= 0) && (sectorNumber + numSectors <= NumSectors));
+
+    lock->Acquire();
+    while (i < numSectors) {
+	int sector = sectorNumber + i;
+
+	// reserve a slot for each uncached sector, up to the next
+	// sector that is already in the cache.  Only the first
+	// reservation may wait; after that we hold busy slots, so
+	// the run just ends when no clean slot is at hand.
+	entry = GetEntry(sector, FALSE, &cached);
+	n = 0;
+	if (!cached) {
+	    entry->busy = TRUE;
+	    run[n++] = entry;
+	    while (i + n < numSectors && n < maxRun) {
+		CacheEntry *next = TakeCleanSlot(sector + n);
+
+		if (next == NULL) {
+		    break;
+		}
+		next->busy = TRUE;
+		run[n++] = next;
+	    }
+	}
+
+	if (n == 0) {			// "entry" is a cache hit
+	    kernel->stats->numCacheHits++;
+	    if (entry->prefetched) {	// read-ahead paid off
+		kernel->stats->numReadAheadHits++;
+		entry->prefetched = FALSE;
+	    }
+	    bcopy(entry->data, &data[i * SectorSize], SectorSize);
+	    i++;
+	    continue;
+	}
+
+	kernel->stats->numCacheMisses += n;
+	lock->Release();
+	synchDisk->ReadSectors(sector, &data[i * SectorSize], n);
+	lock->Acquire();
+	for (int j = 0; j < n; j++) {
+	    bcopy(&data[(i + j) * SectorSize], run[j]->data, SectorSize);
+	    run[j]->busy = FALSE;
+	}
+	slotFree->Broadcast(lock);
+	i += n;
+    }
+    lock->Release();
+    delete [] run;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::WriteSector
+// 	Write the contents of a buffer into the cached copy of a disk
+//	sector.  The sector is marked dirty, and written to disk later.
+//
+//	Since the whole sector is overwritten, there is no need to read
+//	the old contents in on a miss.
+//
+//	"sectorNumber" -- the disk sector to be written
+//	"data" -- the new contents of the disk sector
+//----------------------------------------------------------------------
+
+void
+SectorCache::WriteSector(int sectorNumber, char* data)
+{
+    CacheEntry *entry;
+
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+
+    lock->Acquire();
+    entry = GetEntry(sectorNumber, FALSE);
+    bcopy(data, entry->data, SectorSize);
+    entry->dirty = TRUE;
+    entry->prefetched = FALSE;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SectorCache::Flush
+// 	Write every dirty sector in the cache back to disk.  The sectors
+//	stay cached (clean) afterwards.
+//
+//	"from", "to" -- only flush the sectors in [from, to); the whole
+//	disk by default
+//
+//	Dirty sectors are written in sector order, and each run of
+//	consecutive dirty sectors goes to the disk as a single request.
+//----------------------------------------------------------------------
+
+void
+SectorCache::Flush(int from, int to)
+{
+    char *buf = new char[numEntries * SectorSize];
+    CacheEntry **run = new CacheEntry *[numEntries];
+    int sector = from, n;
+
+    lock->Acquire();
+    while (sector < to) {
+	for (n = 0; sector + n < to && n < numEntries; n++) {
+	    int slot = slotOf[sector + n];
+	    CacheEntry *entry;
+
+	    if (slot == -1) {
+		break;
+	    }
+	    entry = &entries[slot];
+	    if (entry->busy) {
+		if (n > 0) {		// write out what we have first
+		    break;
+		}
+		slotFree->Wait(lock);
+		n--;			// and look at this sector again
+		continue;
+	    }
+	    if (!entry->dirty) {
+		break;
+	    }
+	    entry->busy = TRUE;
+	    bcopy(entry->data, &buf[n * SectorSize], SectorSize);
+	    run[n] = entry;
+	}
+	if (n == 0) {
+	    sector++;
+	    continue;
+	}
+
+	DEBUG(dbgFile, "Cache: flushing " << n << " sectors at " << sector);
+	lock->Release();
+	synchDisk->WriteSectors(sector, buf, n);
+	lock->Acquire();
+	for (int i = 0; i < n; i++) {
+	    run[i]->dirty = FALSE;
+	    run[i]->busy = FALSE;
+	}
+	slotFree->Broadcast(lock);
+	sector += n;
+    }
+    lock->Release();
+    delete [] run;
+    delete [] buf;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::FindVictim
+// 	Run the clock hand until we find a slot that is free, or has not
+//	been referenced since the last time the hand passed it.  Busy slots
+//	are skipped.  Two full sweeps are enough to clear every reference
+//	bit, so if we still have not found anything, every slot is busy.
+//
+//	Return the slot number, or -1 if every slot is busy.
+//----------------------------------------------------------------------
+
+int
+SectorCache::FindVictim()
+{
+    for (int i = 0; i < 2 * numEntries; i++) {
+	int slot = hand;
+	CacheEntry *entry = &entries[slot];
+
+	hand = (hand + 1) % numEntries;
+	if (entry->busy) {
+	    continue;
+	}
+	if (entry->sector == -1 || !entry->referenced) {
+	    return slot;
+	}
+	entry->referenced = FALSE;		// give it a second chance
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::TakeCleanSlot
+// 	Give "sectorNumber" a slot of its own, if it is not cached and
+//	that can be done without waiting: the victim must be free or
+//	clean, so nothing has to be written back.  The slot is not
+//	filled in.
+//
+//	Return the slot, or NULL if the sector is cached or no clean
+//	slot was found.  The cache lock must be held; it is never
+//	released.
+//
+//	"sectorNumber" -- the disk sector wanted
+//----------------------------------------------------------------------
+
+CacheEntry *
+SectorCache::TakeCleanSlot(int sectorNumber)
+{
+    CacheEntry *entry;
+    int slot;
+
+    if (slotOf[sectorNumber] != -1) {
+	return NULL;
+    }
+    slot = FindVictim();
+    if (slot == -1 || entries[slot].dirty) {
+	return NULL;
+    }
+    entry = &entries[slot];
+    if (entry->sector != -1) {
+	slotOf[entry->sector] = -1;
+    }
+    entry->sector = sectorNumber;
+    entry->referenced = TRUE;
+    entry->prefetched = FALSE;
+    slotOf[sectorNumber] = slot;
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::GetEntry
+// 	Return the slot holding "sectorNumber", allocating one if it is
+//	not cached.  If the victim slot is dirty, it is written back first.
+//	If "fill" is set, a newly allocated slot is read in from disk.
+//	If "wasCached" is given, it is set to whether the sector was
+//	already in the cache.
+//
+//	The cache lock must be held; it is released while waiting for the
+//	disk, so everything is re-checked after each I/O.
+//
+//	"sectorNumber" -- the disk sector wanted
+//	"fill" -- should the slot be loaded with the sector's contents?
+//	"wasCached" -- if not NULL, where to say whether it was a hit
+//----------------------------------------------------------------------
+
+CacheEntry *
+SectorCache::GetEntry(int sectorNumber, bool fill, bool *wasCached)
+{
+    CacheEntry *entry;
+    int slot;
+
+    for (;;) {
+	slot = slotOf[sectorNumber];
+	if (slot != -1) {			// cached
+	    entry = &entries[slot];
+	    if (entry->busy) {
+		slotFree->Wait(lock);
+		continue;
+	    }
+	    entry->referenced = TRUE;
+	    if (wasCached != NULL) {
+		*wasCached = TRUE;
+	    }
+	    return entry;
+	}
+
+	slot = FindVictim();
+	if (slot == -1) {			// everything is busy, wait
+	    slotFree->Wait(lock);
+	    continue;
+	}
+	entry = &entries[slot];
+	if (entry->dirty) {			// write the old sector back
+	    DEBUG(dbgFile, "Cache: writing back sector " << entry->sector);
+	    entry->busy = TRUE;
+	    lock->Release();
+	    synchDisk->WriteSector(entry->sector, entry->data);
+	    lock->Acquire();
+	    entry->dirty = FALSE;
+	    entry->busy = FALSE;
+	    slotFree->Broadcast(lock);
+	    continue;				// someone may have cached
+						// our sector meanwhile
+	}
+
+	if (entry->sector != -1) {
+	    slotOf[entry->sector] = -1;
+	}
+	entry->sector = sectorNumber;
+	entry->referenced = TRUE;
+	entry->prefetched = FALSE;
+	slotOf[sectorNumber] = slot;
+	if (fill) {
+	    entry->busy = TRUE;
+	    lock->Release();
+	    synchDisk->ReadSector(sectorNumber, entry->data);
+	    lock->Acquire();
+	    entry->busy = FALSE;
+	    slotFree->Broadcast(lock);
+	}
+	if (wasCached != NULL) {
+	    *wasCached = FALSE;
+	}
+	return entry;
+    }
+}
+
+//----------------------------------------------------------------------
+// SectorCache::Prefetch
+// 	Queue a sector to be read into the cache by the read-ahead
+//	thread.  Return right away; sectors that are already cached
+//	are not queued.
+//
+//	"sectorNumber" -- the disk sector that will probably be read soon
+//----------------------------------------------------------------------
+
+void
+SectorCache::Prefetch(int sectorNumber)
+{
+    if (sectorNumber < 0 || sectorNumber >= NumSectors) {
+	return;
+    }
+    lock->Acquire();
+    if (slotOf[sectorNumber] == -1) {
+	DEBUG(dbgFile, "Cache: queueing read-ahead of sector " << sectorNumber);
+	readAheadList->Append(sectorNumber);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SectorCache::ReadAheadDaemon
+// 	Entry point of the read-ahead thread; Thread::Fork can only
+//	call a plain function.
+//----------------------------------------------------------------------
+
+void
+SectorCache::ReadAheadDaemon(SectorCache *cache)
+{
+    cache->ReadAhead();
+}
+
+//----------------------------------------------------------------------
+// SectorCache::ReadAhead
+// 	Loop forever, reading queued sectors into the cache.  A sector
+//	may have been read (or written) by someone else since it was
+//	queued, in which case there is nothing to do.
+//
+//	Prefetched slots are marked, so the first ReadSector that finds
+//	one can be counted as a read-ahead hit.
+//----------------------------------------------------------------------
+
+void
+SectorCache::ReadAhead()
+{
+    for (;;) {
+	int sectorNumber = readAheadList->RemoveFront();
+	CacheEntry *entry;
+
+	lock->Acquire();
+	if (slotOf[sectorNumber] == -1) {
+	    entry = GetEntry(sectorNumber, TRUE);
+	    entry->prefetched = TRUE;
+	    kernel->stats->numReadAheads++;
+	}
+	lock->Release();
+    }
+}
@@ -0,0 +1,96 @@
+// sectorcache.h
+//	Data structures for a write-back cache of disk sectors, sitting
+//	between the file system and the synchronous disk.
+//
+//	Every file header, indirect block, directory and data sector
+//	is read and written through this cache, so re-reading a hot
+//	sector does not pay seek + rotational latency again.  Modified
+//	sectors are only written to disk when they are evicted, or when
+//	the cache is flushed (at file system shutdown).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef SECTORCACHE_H
+#define SECTORCACHE_H
+
+#include "disk.h"
+#include "synch.h"
+#include "synchlist.h"
+
+class SynchDisk;
+
+#define DefaultCacheSectors 	64	// cache size if -bc is not given
+
+// The following class defines one slot of the sector cache.
+//
+// "busy" is set while the slot is being filled from, or written back
+// to, the disk; other threads that want the slot wait until it clears.
+
+class CacheEntry {
+  public:
+    int sector;				// disk sector held here, -1 if free
+    bool dirty;				// modified since read from disk?
+    bool busy;				// disk I/O in progress on this slot?
+    bool referenced;			// used since the clock hand passed?
+    bool prefetched;			// read ahead, and not yet asked for?
+    char data[SectorSize];		// contents of the sector
+};
+
+// The following class defines the sector cache.  Replacement uses
+// the CLOCK (second-chance) algorithm over the cache slots.
+
+class SectorCache {
+  public:
+    SectorCache(SynchDisk *disk, int numEntries);
+					// Create a cache of "numEntries"
+					// sectors on top of "disk"
+    ~SectorCache();			// Flush and de-allocate the cache
+
+    void ReadSector(int sectorNumber, char* data);
+    					// Read/write a sector through the
+					// cache; same interface as SynchDisk
+    void WriteSector(int sectorNumber, char* data);
+
+    void ReadSectors(int sectorNumber, char* data, int numSectors);
+					// Read a run of consecutive sectors,
+					// fetching each uncached stretch
+					// with a single disk request
+
+    void Flush(int from = 0, int to = NumSectors);
+					// Write every dirty sector in
+					// [from, to) back to disk
+
+    void Prefetch(int sectorNumber);	// Ask for a sector to be read
+					// into the cache in the background
+
+  private:
+    SynchDisk *synchDisk;		// Underlying synchronous disk
+    CacheEntry *entries;		// The cache slots
+    int numEntries;			// Number of cache slots
+    int *slotOf;			// Sector # -> slot #, or -1
+    int hand;				// CLOCK hand
+    Lock *lock;				// Protects the slots and slotOf
+    Condition *slotFree;		// Signalled whenever a slot stops
+					// being busy
+    SynchList<int> *readAheadList;	// Sectors waiting to be prefetched
+
+    static void ReadAheadDaemon(SectorCache *cache);
+    void ReadAhead();			// Body of the read-ahead thread
+
+    int FindVictim();			// Pick a slot to replace, -1 if
+					// every slot is busy
+    CacheEntry *GetEntry(int sectorNumber, bool fill,
+			 bool *wasCached = NULL);
+					// Return the (non-busy) slot holding
+					// "sectorNumber", loading it from
+					// disk if "fill"; lock must be held
+    CacheEntry *TakeCleanSlot(int sectorNumber);
+					// Slot for an uncached sector, if one
+					// can be had without waiting
+};
+
+#endif // SECTORCACHE_H
@@ -5,10 +5,13 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Because the physical disk can only handle one operation at a
+//	time, requests that arrive while it is busy are put on a queue.
+//	Each request has its own semaphore, which the interrupt handler
+//	signals when that request is done; the handler then picks the
+//	next request to send to the disk according to the scheduling
+//	policy.  The queue is shared with the interrupt handler, so it is
+//	protected by disabling interrupts rather than by a lock.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,20 +19,24 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
-
+#include "main.h"
 
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
 // 	Initialize the synchronous interface to the physical disk, in turn
 //	initializing the physical disk.
 //
+//	"policy" -- how to order requests waiting for the disk
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk()
+SynchDisk::SynchDisk(DiskPolicy policy)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
+    this->policy = policy;
+    pending = new List<DiskRequest *>;
+    current = NULL;
+    headSector = 0;
     disk = new Disk(this);
+    kernel->stats->diskPolicy = PolicyName(policy);
 }
 
 //----------------------------------------------------------------------
@@ -41,8 +48,7 @@ SynchDisk::SynchDisk()
 SynchDisk::~SynchDisk()
 {
     delete disk;
-    delete lock;
-    delete semaphore;
+    delete pending;
 }
 
 //----------------------------------------------------------------------
@@ -57,10 +63,7 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    Request(sectorNumber, data, 1, FALSE);
 }
 
 //----------------------------------------------------------------------
@@ -75,22 +78,232 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    Request(sectorNumber, data, 1, TRUE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors/WriteSectors
+// 	Read/write a run of consecutive disk sectors, with a single disk
+//	request.  Return only after all of them have been transferred.
+//
+//	"sectorNumber" -- the first disk sector of the run
+//	"data" -- the buffer, numSectors * SectorSize bytes long
+//	"numSectors" -- the length of the run
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(int sectorNumber, char* data, int numSectors)
+{
+    Request(sectorNumber, data, numSectors, FALSE);
+}
+
+void
+SynchDisk::WriteSectors(int sectorNumber, char* data, int numSectors)
+{
+    Request(sectorNumber, data, numSectors, TRUE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Request
+// 	Queue a read or write, start it right away if the disk is idle,
+//	and wait until the interrupt handler says it is done.
+//
+//	"sectorNumber" -- the first disk sector to read/write
+//	"data" -- the buffer to read into/write from
+//	"numSectors" -- the number of consecutive sectors
+//	"writing" -- is this a write?
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Request(int sectorNumber, char *data, int numSectors,
+		   bool writing)
+{
+    DiskRequest request;
+    IntStatus oldLevel;
+
+    ASSERT((sectorNumber >= 0) && (numSectors > 0)
+	   && (sectorNumber + numSectors <= NumSectors));
+    request.sector = sectorNumber;
+    request.numSectors = numSectors;
+    request.data = data;
+    request.writing = writing;
+    request.arrival = kernel->stats->totalTicks;
+    request.done = new Semaphore("disk request", 0);
+
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    pending->Append(&request);
+    if (current == NULL) {
+	StartNext();
+    }
+    (void) kernel->interrupt->SetLevel(oldLevel);
+
+    request.done->P();			// wait for interrupt
+    delete request.done;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::CallBack
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Account for the request that just
+//	finished, wake up the thread waiting for it, and start the
+//	next pending request, if any.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::CallBack()
 { 
-    semaphore->V();
+    DiskRequest *request = current;
+    Statistics *stats = kernel->stats;
+    int wait;
+
+    ASSERT(request != NULL);
+    current = NULL;
+
+    wait = stats->totalTicks - request->arrival;
+    stats->numDiskRequests++;
+    stats->numDiskSectors += request->numSectors;
+    stats->diskQueueTicks += request->start - request->arrival;
+    stats->diskServiceTicks += stats->totalTicks - request->start;
+    if (wait > stats->maxDiskWait) {
+	stats->maxDiskWait = wait;
+    }
+    request->done->V();
+
+    if (!pending->IsEmpty()) {
+	StartNext();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartNext
+// 	Take the next request off the queue and send it to the disk.
+//	Interrupts must be disabled, and the disk must be idle.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartNext()
+{
+    DiskRequest *request = PickNext();
+
+    pending->Remove(request);
+    current = request;
+    headSector = request->sector;
+    request->start = kernel->stats->totalTicks;
+    DEBUG(dbgDisk, "Scheduling " << (request->writing ? "write" : "read")
+	  << " of " << request->numSectors << " sectors at " << request->sector);
+    if (request->writing) {
+	disk->WriteRequest(request->sector, request->data, request->numSectors);
+    } else {
+	disk->ReadRequest(request->sector, request->data, request->numSectors);
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::PickNext
+// 	Return the pending request that should go to the disk next,
+//	according to the scheduling policy.  The queue must not be empty.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::PickNext()
+{
+    DiskRequest *oldest = pending->Front();
+    DiskRequest *best = oldest;
+    int headTrack = headSector / SectorsPerTrack;
+    int bestDistance, distance;
+
+    switch (policy) {
+      case DiskFIFO:
+	return oldest;
+
+      case DiskSSTF:	// ties go to the oldest request
+	bestDistance = abs(best->sector / SectorsPerTrack - headTrack);
+	for (ListIterator<DiskRequest *> it(pending); !it.IsDone(); it.Next()) {
+	    distance = abs(it.Item()->sector / SectorsPerTrack - headTrack);
+	    if (distance < bestDistance) {
+		best = it.Item();
+		bestDistance = distance;
+	    }
+	}
+	return best;
+
+      case DiskDeadline:
+	// the queue is in arrival order, so only the oldest request
+	// can be the first to miss its deadline
+	if (kernel->stats->totalTicks - oldest->arrival > DiskDeadlineTicks) {
+	    return oldest;
+	}
+	return PickCLOOK();
+
+      case DiskCLOOK:
+      default:
+	return PickCLOOK();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::PickCLOOK
+// 	Return the pending request with the lowest sector number at or
+//	beyond the head; if there is none, the sweep is over, so start
+//	again from the lowest pending sector.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::PickCLOOK()
+{
+    DiskRequest *ahead = NULL, *lowest = NULL;
+
+    for (ListIterator<DiskRequest *> it(pending); !it.IsDone(); it.Next()) {
+	DiskRequest *request = it.Item();
+
+	if (lowest == NULL || request->sector < lowest->sector) {
+	    lowest = request;
+	}
+	if (request->sector >= headSector
+	    && (ahead == NULL || request->sector < ahead->sector)) {
+	    ahead = request;
+	}
+    }
+    return (ahead != NULL) ? ahead : lowest;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ParsePolicy
+// 	Return the scheduling policy with the given name (as given to
+//	the -ds flag).
+//----------------------------------------------------------------------
+
+DiskPolicy
+SynchDisk::ParsePolicy(char *name)
+{
+    if (strcmp(name, "fifo") == 0) {
+	return DiskFIFO;
+    } else if (strcmp(name, "sstf") == 0) {
+	return DiskSSTF;
+    } else if (strcmp(name, "clook") == 0) {
+	return DiskCLOOK;
+    } else if (strcmp(name, "deadline") == 0) {
+	return DiskDeadline;
+    }
+    cerr << "Unknown disk scheduling policy: " << name << "\n";
+    ASSERT(FALSE);
+    return DiskFIFO;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::PolicyName
+// 	Return the name of a scheduling policy, for printing statistics.
+//----------------------------------------------------------------------
+
+char *
+SynchDisk::PolicyName(DiskPolicy policy)
+{
+    switch (policy) {
+      case DiskFIFO:	 return "fifo";
+      case DiskSSTF:	 return "sstf";
+      case DiskCLOOK:	 return "clook";
+      case DiskDeadline: return "deadline";
+    }
+    return "unknown";
 }
 
 Locks::Locks() {
@@ -14,6 +14,7 @@
 #include "disk.h"
 #include "synch.h"
 #include "callback.h"
+#include "list.h"
 
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
@@ -25,6 +26,35 @@
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
 // returning.
+//
+// Requests from different threads are queued while the disk is busy.
+// Whenever the disk finishes a request, the next one is picked from the
+// queue according to the scheduling policy:
+//
+//	DiskFIFO	-- in arrival order
+//	DiskSSTF	-- shortest seek (fewest tracks from the head) first
+//	DiskCLOOK	-- sweep up through the sector numbers, then jump
+//			   back to the lowest pending sector
+//	DiskDeadline	-- C-LOOK, but a request that has waited longer
+//			   than DiskDeadlineTicks is served first
+
+enum DiskPolicy { DiskFIFO, DiskSSTF, DiskCLOOK, DiskDeadline };
+
+#define DiskDeadlineTicks	100000	// max wait under DiskDeadline,
+					// before a request jumps the queue
+
+// A read or write waiting for (or using) the disk.
+
+class DiskRequest {
+  public:
+    int sector;				// the first sector to read/write
+    int numSectors;			// how many consecutive sectors
+    char *data;				// the buffer to read into/write from
+    bool writing;			// write request?
+    int arrival;			// when the request was queued
+    int start;				// when it was sent to the disk
+    Semaphore *done;			// V'ed when the request completes
+};
 
 #include <map>
 
@@ -38,7 +68,7 @@ public:
 
 class SynchDisk : public CallBackObj {
   public:
-    SynchDisk();    		        // Initialize a synchronous disk,
+    SynchDisk(DiskPolicy policy);	// Initialize a synchronous disk,
 					// by initializing the raw Disk.
     ~SynchDisk();			// De-allocate the synch disk data
     
@@ -49,17 +79,36 @@ class SynchDisk : public CallBackObj {
     					// Disk::ReadRequest/WriteRequest and
 					// then wait until the request is done.
     void WriteSector(int sectorNumber, char* data);
+
+    void ReadSectors(int sectorNumber, char* data, int numSectors);
+    void WriteSectors(int sectorNumber, char* data, int numSectors);
+					// Same, for a run of consecutive
+					// sectors, moved in one disk request
     
     void CallBack();			// Called by the disk device interrupt
 					// handler, to signal that the
 					// current disk operation is complete.
 
+    static DiskPolicy ParsePolicy(char *name);
+					// Policy named "fifo", "sstf",
+					// "clook" or "deadline"
+    static char *PolicyName(DiskPolicy policy);
+
   private:
     Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    DiskPolicy policy;			// How to order pending requests
+    List<DiskRequest *> *pending;	// Requests waiting for the disk
+    DiskRequest *current;		// Request the disk is working on,
+					// NULL if the disk is idle
+    int headSector;			// Sector of the last request sent
+					// to the disk
+
+    void Request(int sectorNumber, char *data, int numSectors,
+		 bool writing);
+					// Queue a request and wait for it
+    DiskRequest *PickNext();		// Choose the next pending request
+    DiskRequest *PickCLOOK();
+    void StartNext();			// Send the next request to the disk
 };
 
 #endif // SYNCHDISK_H
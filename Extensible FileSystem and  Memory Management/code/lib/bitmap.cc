@@ -2,6 +2,11 @@
 //	Routines to manage a bitmap -- an array of bits each of which
 //	can be either on or off.  Represented as an array of integers.
 //
+//	The search and counting routines work a whole word at a time:
+//	a word with no clear bits is skipped with one comparison, the
+//	first clear bit of a word is found with count-trailing-zeros,
+//	and clear bits are counted with popcount.
+//
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -57,7 +62,7 @@ Bitmap::Mark(int which)
 { 
     ASSERT(which >= 0 && which < numBits);
 
-    map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    map[which / BitsInWord] |= 1U << (which % BitsInWord);
 
     ASSERT(Test(which));
 }
@@ -74,7 +79,7 @@ Bitmap::Clear(int which)
 {
     ASSERT(which >= 0 && which < numBits);
 
-    map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    map[which / BitsInWord] &= ~(1U << (which % BitsInWord));
 
     ASSERT(!Test(which));
 }
@@ -91,13 +96,58 @@ Bitmap::Test(int which) const
 {
     ASSERT(which >= 0 && which < numBits);
     
-    if (map[which / BitsInWord] & (1 << (which % BitsInWord))) {
+    if (map[which / BitsInWord] & (1U << (which % BitsInWord))) {
 	return TRUE;
     } else {
 	return FALSE;
     }
 }
 
+//----------------------------------------------------------------------
+// RangeMask
+// 	Return a word with bits [from, to) of word "w" set, where "from"
+//	and "to" are bit numbers in the whole bitmap.
+//----------------------------------------------------------------------
+
+static unsigned int
+RangeMask(int w, int from, int to)
+{
+    int lo = max(from - w * BitsInWord, 0);
+    int hi = min(to - w * BitsInWord, BitsInWord);
+    unsigned int mask = ~0U;
+
+    mask <<= lo;
+    if (hi < BitsInWord) {
+	mask &= (1U << hi) - 1;
+    }
+    return mask;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::FindBit
+// 	Return the number of the first bit in [from, to) that is set
+//	(if "set" is TRUE) or clear (if FALSE), or -1 if there is none.
+//	Whole words that cannot contain such a bit are skipped.
+//----------------------------------------------------------------------
+
+int
+Bitmap::FindBit(bool set, int from, int to) const
+{
+    ASSERT(from >= 0 && to <= numBits);
+
+    if (from >= to) {
+	return -1;
+    }
+    for (int w = from / BitsInWord; w <= (to - 1) / BitsInWord; w++) {
+	unsigned int bits = (set ? map[w] : ~map[w]) & RangeMask(w, from, to);
+
+	if (bits != 0) {
+	    return w * BitsInWord + __builtin_ctz(bits);
+	}
+    }
+    return -1;
+}
+
 //----------------------------------------------------------------------
 // Bitmap::FindAndSet
 // 	Return the number of the first bit which is clear.
@@ -110,13 +160,7 @@ Bitmap::Test(int which) const
 int 
 Bitmap::FindAndSet() 
 {
-    for (int i = 0; i < numBits; i++) {
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
-	}
-    }
-    return -1;
+    return FindAndSetRange(0, numBits);
 }
 
 //----------------------------------------------------------------------
@@ -128,13 +172,51 @@ Bitmap::FindAndSet()
 int
 Bitmap::FindAndSetRange(int from, int to)
 {
-  for (int i = from; i < to; i++) {
-    if (!Test(i)) {
-      Mark(i);
-      return i;
-    }
+  int which = FindBit(FALSE, from, to);
+
+  if (which != -1) {
+    Mark(which);
   }
-  return -1;
+  return which;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::FindContiguousRange
+// 	Return the number of the first bit of the first run of "count"
+//	clear bits in [from, to), or -1 if there is none.  The bits are
+//	not marked.  Runs are found by hopping from the start of a clear
+//	run to the next set bit and back, so this is a word-level scan.
+//
+//	"count" is the length of the run wanted
+//	"from", "to" bound the search (the whole bitmap if not given)
+//----------------------------------------------------------------------
+
+int
+Bitmap::FindContiguousRange(int count) const
+{
+    return FindContiguousRange(count, 0, numBits);
+}
+
+int
+Bitmap::FindContiguousRange(int count, int from, int to) const
+{
+    ASSERT(count > 0);
+
+    while (from < to) {
+	int start = FindBit(FALSE, from, to);	// start of a clear run
+	if (start == -1 || to - start < count) {
+	    return -1;
+	}
+	int end = FindBit(TRUE, start, to);	// end of the clear run
+	if (end == -1) {
+	    end = to;
+	}
+	if (end - start >= count) {
+	    return start;
+	}
+	from = end;
+    }
+    return -1;
 }
 
 //----------------------------------------------------------------------
@@ -146,14 +228,7 @@ Bitmap::FindAndSetRange(int from, int to)
 int 
 Bitmap::NumClear() const
 {
-    int count = 0;
-
-    for (int i = 0; i < numBits; i++) {
-	if (!Test(i)) {
-	    count++;
-	}
-    }
-    return count;
+    return NumClearRange(0, numBits);
 }
 
 //----------------------------------------------------------------------
@@ -166,10 +241,12 @@ Bitmap::NumClearRange(int from, int to) const
 {
   int count = 0;
 
-  for (int i = from; i < to; i++) {
-    if (!Test(i)) {
-      count++;
-    }
+  ASSERT(from >= 0 && to <= numBits);
+  if (from >= to) {
+    return 0;
+  }
+  for (int w = from / BitsInWord; w <= (to - 1) / BitsInWord; w++) {
+    count += __builtin_popcount(~map[w] & RangeMask(w, from, to));
   }
   return count;
 }
@@ -205,7 +282,7 @@ Bitmap::SelfTest()
 {
     int i;
     
-    ASSERT(numBits >= BitsInWord);	// bitmap must be big enough
+    ASSERT(numBits > 2 * BitsInWord);	// bitmap must be big enough
 
     ASSERT(NumClear() == numBits);	// bitmap must be empty
     ASSERT(FindAndSet() == 0);
@@ -221,7 +298,26 @@ Bitmap::SelfTest()
         Mark(i);
     }
     ASSERT(FindAndSet() == -1);		// bitmap should be full!
+    ASSERT(NumClear() == 0);
+    ASSERT(FindContiguousRange(1) == -1);
+
+    // open a few holes, straddling word boundaries
+    Clear(BitsInWord - 1);
+    Clear(BitsInWord);
+    Clear(BitsInWord + 1);
+    Clear(numBits - 1);
+    ASSERT(NumClear() == 4);
+    ASSERT(NumClearRange(BitsInWord, numBits) == 3);
+    ASSERT(NumClearRange(BitsInWord, BitsInWord + 1) == 1);
+    ASSERT(FindContiguousRange(3) == BitsInWord - 1);
+    ASSERT(FindContiguousRange(4) == -1);
+    ASSERT(FindContiguousRange(1, BitsInWord + 2, numBits) == numBits - 1);
+    ASSERT(FindAndSetRange(BitsInWord, numBits) == BitsInWord);
+    ASSERT(FindAndSet() == BitsInWord - 1);
+    ASSERT(FindContiguousRange(2) == -1);
+
     for (i = 0; i < numBits; i++) {
         Clear(i);
     }
+    ASSERT(FindContiguousRange(numBits) == 0);
 }
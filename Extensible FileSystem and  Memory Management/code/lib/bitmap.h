@@ -48,6 +48,11 @@ class Bitmap {
     void SelfTest();		// Test whether bitmap is working
     int FindAndSetRange(int from, int to);
     int NumClearRange(int from, int to) const;
+    int FindContiguousRange(int count) const;
+				// Return the # of the first bit of
+				// "count" clear bits in a row, or -1
+    int FindContiguousRange(int count, int from, int to) const;
+				// Same, looking only in [from, to)
 
   protected:
     int numBits;		// number of bits in the bitmap
@@ -56,6 +61,10 @@ class Bitmap {
 				//  multiple of the number of bits in
 				//  a word)
     unsigned int *map;		// bit storage
+
+  private:
+    int FindBit(bool set, int from, int to) const;
+				// First set (or clear) bit in [from, to)
 };
 
 #endif // BITMAP_H
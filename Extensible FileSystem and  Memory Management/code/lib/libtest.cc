@@ -83,3 +83,109 @@ LibSelfTest () {
     delete sortList;
     delete hashTable;
 }
+
+//----------------------------------------------------------------------
+// BitFindAndSet, BitNumClear, BitFindContiguous
+//	The bitmap scans done one bit at a time through Test, the way
+//	Bitmap used to do them.  Kept here as the baseline for
+//	LibBenchmark.
+//----------------------------------------------------------------------
+
+static int
+BitFindAndSet(Bitmap *map, int numBits)
+{
+    for (int i = 0; i < numBits; i++) {
+	if (!map->Test(i)) {
+	    map->Mark(i);
+	    return i;
+	}
+    }
+    return -1;
+}
+
+static int
+BitNumClear(Bitmap *map, int numBits)
+{
+    int count = 0;
+
+    for (int i = 0; i < numBits; i++) {
+	if (!map->Test(i)) {
+	    count++;
+	}
+    }
+    return count;
+}
+
+static int
+BitFindContiguous(Bitmap *map, int numBits, int count)
+{
+    int run = 0;
+
+    for (int i = 0; i < numBits; i++) {
+	if (map->Test(i)) {
+	    run = 0;
+	} else if (++run == count) {
+	    return i - count + 1;
+	}
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// BitmapBenchmark
+//	Time FindAndSet, NumClear and FindContiguousRange on a bitmap of
+//	"numBits" bits that is full except for the last few bits -- the
+//	worst case for a scan, and what an almost full disk or memory
+//	looks like.  Print bits scanned per second, bit-at-a-time versus
+//	word-at-a-time.
+//----------------------------------------------------------------------
+
+static void
+BitmapBenchmark(int numBits)
+{
+    const int freeBits = 8;
+    Bitmap *map = new Bitmap(numBits);
+    int rounds = max(1, (1 << 22) / numBits);	// scan ~4M bits per test
+    int check = 0;
+    double start, oldTime, newTime;
+
+    for (int i = 0; i < numBits - freeBits; i++) {
+	map->Mark(i);
+    }
+
+    start = HostTime();
+    for (int r = 0; r < rounds; r++) {
+	map->Clear(BitFindAndSet(map, numBits));
+	check += BitNumClear(map, numBits);
+	check += BitFindContiguous(map, numBits, freeBits);
+    }
+    oldTime = HostTime() - start;
+
+    start = HostTime();
+    for (int r = 0; r < rounds; r++) {
+	map->Clear(map->FindAndSet());
+	check -= map->NumClear();
+	check -= map->FindContiguousRange(freeBits);
+    }
+    newTime = HostTime() - start;
+    ASSERT(check == 0);			// both did the same thing
+
+    double bits = 3.0 * rounds * numBits;
+    cout << "Bitmap " << numBits << " bits: bit-at-a-time "
+	 << bits / oldTime / 1e6 << " Mbit/s, word-at-a-time "
+	 << bits / newTime / 1e6 << " Mbit/s, speedup "
+	 << oldTime / newTime << "\n";
+    delete map;
+}
+
+//----------------------------------------------------------------------
+// LibBenchmark
+//	Run the micro-benchmarks for library routines.
+//----------------------------------------------------------------------
+
+void
+LibBenchmark () {
+    for (int numBits = 1 << 10; numBits <= 1 << 20; numBits <<= 2) {
+	BitmapBenchmark(numBits);
+    }
+}
@@ -194,6 +194,22 @@ RandomNumber()
     return rand();
 }
 
+//----------------------------------------------------------------------
+// HostTime
+// 	Return the wall clock time of the host, in seconds.  This has
+//	nothing to do with simulated time; it is only used to measure how
+//	fast the simulator itself runs.
+//----------------------------------------------------------------------
+
+double
+HostTime()
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return now.tv_sec + now.tv_usec / 1000000.0;
+}
+
 //----------------------------------------------------------------------
 // AllocBoundedArray
 // 	Return an array, with the two pages just before 
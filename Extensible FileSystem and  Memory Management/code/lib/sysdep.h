@@ -32,6 +32,9 @@ extern void CallOnUserAbort(void (*cleanup)(int));
 extern void RandomInit(unsigned seed);
 extern unsigned int RandomNumber();
 
+// Host wall clock time in seconds, for timing benchmarks
+extern double HostTime();
+
 // Allocate, de-allocate an array, such that de-referencing
 // just beyond either end of the array will cause an error
 extern char *AllocBoundedArray(int size);
@@ -2,76 +2,92 @@
 
 LRUCache::LRUCache(int cap) {
   capibility = cap;
-  head = tail = NULL;
-  nodeMap = new map< TranslationEntry*, Node*>();
+  head = tail = -1;
+  size = 0;
+  next = new int[cap];
+  prev = new int[cap];
+  LRUTime = new int[cap];
+  inList = new bool[cap];
+  referenced = new bool[cap];
+  for (int i = 0; i < cap; i++) {
+    next[i] = prev[i] = -1;
+    LRUTime[i] = 0;
+    inList[i] = referenced[i] = FALSE;
+  }
 } // constructor
 
-TranslationEntry* 
-LRUCache::set(int LRUtime, TranslationEntry* entry) {
-  TranslationEntry* removedValue = NULL;
-  Node *node = NULL;
-  //Node *currentNode = getNode(value);
-  if (nodeMap->find(entry) != nodeMap->end()) { // if the key is already in the map, update value and put the node to the end
-    node = (*nodeMap)[entry];
-    node->LRUTime = LRUtime;
-    removeNode(node);
-    //tranList->Remove(currentNode);
-    //currentNode->LRUTime = LRUtime;
-  }
-  else if (size < capibility) {
-    node = new Node(entry, LRUtime);
-  }
-  else { // oversize
-    node = tail; //select the least recent used node. 
-    removedValue = tail->entry;
-    removeNode(node);
-    node->update(entry, LRUtime);
+LRUCache::~LRUCache() {
+  delete [] next;
+  delete [] prev;
+  delete [] LRUTime;
+  delete [] inList;
+  delete [] referenced;
+}
+
+void
+LRUCache::set(int LRUtime, int frame) {
+  if (inList[frame]) { // already in the list, move it to the front
+    unlink(frame);
   }
+  referenced[frame] = FALSE;
+  pushFront(frame, LRUtime);
+}
 
-  appendNode(node);// put new entry into the end of the list
+void
+LRUCache::remove(int frame) {
+  if (inList[frame]) {
+    unlink(frame);
+  }
+  referenced[frame] = FALSE;
+}
 
-  return removedValue; // return the deleted value
+void
+LRUCache::sweep(int LRUtime) { // O(pages), no allocation
+  for (int frame = 0; frame < capibility; frame++) {
+    if (inList[frame] && referenced[frame]) {
+      referenced[frame] = FALSE;
+      unlink(frame);
+      pushFront(frame, LRUtime);
+    }
+  }
 }
 
-Node*
-LRUCache::oldestNode() {
+int
+LRUCache::oldest() {
   return tail;
 }
 
-Node* 
-LRUCache::removeNode(Node *node) {
-  nodeMap->erase(node->entry);
-  size--;
-  if (node->prev != NULL) {
-    node->prev->next = node->next;
+void
+LRUCache::unlink(int frame) {
+  if (prev[frame] != -1) {
+    next[prev[frame]] = next[frame];
   }
-  if (node->next != NULL) {
-    node->next->prev = node->prev;
+  else {
+    head = next[frame];
   }
-  if (node == head) {
-    head = head->next;
+  if (next[frame] != -1) {
+    prev[next[frame]] = prev[frame];
   }
-  if (node == tail) {
-    tail = tail->prev;
+  else {
+    tail = prev[frame];
   }
-  node->next = NULL;
-  node->prev = NULL;
-
-  return node;
+  next[frame] = prev[frame] = -1;
+  inList[frame] = FALSE;
+  size--;
 }
 
-Node* 
-LRUCache::appendNode(Node *node) {
-  (*nodeMap)[node->entry] = node;
-  size++;
-  if (head == NULL) {
-    head = node;
-    tail = node;
+void
+LRUCache::pushFront(int frame, int LRUtime) {
+  LRUTime[frame] = LRUtime;
+  prev[frame] = -1;
+  next[frame] = head;
+  if (head != -1) {
+    prev[head] = frame;
   }
   else {
-    node->next = head;
-    head->prev = node;
-    head = node;
+    tail = frame;
   }
-  return node;
-}
\ No newline at end of file
+  head = frame;
+  inList[frame] = TRUE;
+  size++;
+}
@@ -4,40 +4,40 @@
 #define LRUCACHE
 #include "../lib/list.h"
 #include "../machine/translate.h"
-#include <map>
 
-struct Node {
-  Node *next;
-  Node *prev;
-  TranslationEntry* entry;
-  int LRUTime;
-  Node(TranslationEntry *entry, int LRUTime) {
-    this->entry = entry;
-    this->LRUTime = LRUTime;
-    next = prev = NULL;
-  }
-
-  void update(TranslationEntry *entry, int LRUTime) {
-    this->entry = entry;
-    this->LRUTime = LRUTime;
-  }
-};
+// LRU order of the physical pages in use, kept in arrays indexed by
+// physical page number, so nothing is allocated or looked up once it
+// is built.  Memory references only set the page's "referenced" flag
+// (through touch); sweep moves every referenced page to the front of
+// the list, as of the time it is called.  The order is thus exact at
+// the granularity of the sweeps, which happen on every timer
+// interrupt and before a victim is picked.
 
 class LRUCache {
 public:
   LRUCache(int cap);
-  TranslationEntry* set(int LRUtime, TranslationEntry* entry);
-  Node* oldestNode();
-  Node* removeNode(Node *node);
-  Node* appendNode(Node *node);
-
-  Node *head;
-  Node *tail;
-  map<TranslationEntry*, Node*> *nodeMap;
+  ~LRUCache();
+  void set(int LRUtime, int frame); // "frame" is in use, and the newest
+  void remove(int frame); // forget a page that was freed or evicted
+  void touch(int frame) { referenced[frame] = TRUE; } // on every reference
+  void sweep(int LRUtime); // move the referenced pages to the front
+  int oldest(); // least recently used page, -1 if none
+  int newer(int frame) { return prev[frame]; } // next one up, -1 if none
+  int lastUsed(int frame) { return LRUTime[frame]; }
+
+private:
+  void unlink(int frame);
+  void pushFront(int frame, int LRUtime);
+
+  int *next; // towards the oldest page, -1 at the tail
+  int *prev; // towards the newest page, -1 at the head
+  int *LRUTime; // time of the sweep that last saw the page used
+  bool *inList;
+  bool *referenced; // used since the last sweep?
+  int head;
+  int tail;
   int capibility;
   int size;
 };
 
 #endif // !LRUCACHE
-
-
@@ -65,19 +65,42 @@ Machine::Machine(bool debug)
     tlb = new TranslationEntry[TLBSize];
     for (i = 0; i < TLBSize; i++)
 	tlb[i].valid = FALSE;
-    pageTable = NULL;
+    pageDirectory = NULL;
 #else	// use linear page table
+    tlbSize = kernel->tlbSize;
+    tlbWays = kernel->tlbWays;
+    tlbPolicy = kernel->tlbPolicy;
+    ASSERT(tlbWays > 0 && tlbSize % tlbWays == 0);
+    tlbSets = tlbSize / tlbWays;
+    tlbNext = NULL;
+    tlbClock = 0;
+    currentAsid = -1;
     if (kernel->useTLB == TRUE) {
-      tlb = new TLBEntry[TLBSize]; // a software TLB is used
-      for (i = 0; i < TLBSize; i++)
+      tlb = new TLBEntry[tlbSize]; // a software TLB is used
+      for (i = 0; i < tlbSize; i++)
         tlb[i].valid = FALSE;
+      tlbNext = new int[tlbSets];
+      for (i = 0; i < tlbSets; i++)
+        tlbNext[i] = 0;
     }
     else {
       tlb = NULL;
     }
 
-    pageTable = NULL;
+    pageDirectory = NULL;
 #endif
+    useDecodeCache = kernel->decodeCache;
+    decoded = NULL;
+    decodedValid = pageDecoded = NULL;
+    if (useDecodeCache) {
+      decoded = new Instruction[MemorySize / 4];
+      decodedValid = new bool[MemorySize / 4];
+      for (i = 0; i < MemorySize / 4; i++)
+        decodedValid[i] = FALSE;
+      pageDecoded = new bool[NumPhysPages];
+      for (i = 0; i < NumPhysPages; i++)
+        pageDecoded[i] = FALSE;
+    }
     singleStep = debug;
     CheckEndian();
 }
@@ -92,6 +115,13 @@ Machine::~Machine()
     delete [] mainMemory;
     if (tlb != NULL)
         delete [] tlb;
+    if (tlbNext != NULL)
+        delete [] tlbNext;
+    if (decoded != NULL) {
+        delete [] decoded;
+        delete [] decodedValid;
+        delete [] pageDecoded;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -41,7 +41,20 @@ const int PageSize = 128; 		// set the page size equal to
 const int NumPhysPages = 128;
 
 const int MemorySize = (NumPhysPages * PageSize);
-const int TLBSize = 4;			// if there is a TLB, make it small
+
+// User page tables have two levels: a directory of PageDirSize
+// pointers, each to a leaf of PageLeafSize page table entries, or
+// NULL if none of the pages it covers is in the address space.
+// Virtual page "vpn" is entry vpn % PageLeafSize of leaf
+// vpn / PageLeafSize.
+const int PageLeafSize = 32;
+const int PageDirSize = 256;
+const int NumVirtPages = (PageDirSize * PageLeafSize);
+const int TLBSize = 4;			// if there is a TLB, make it small;
+					// the default for -ts and -ta
+
+enum TLBPolicy { TLBLRU, TLBFIFO, TLBRandom };
+					// which entry of a set to replace
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -91,9 +104,28 @@ enum ExceptionType { NoException,           // Everything ok!
 // The procedures in this class are defined in machine.cc, mipssim.cc, and
 // translate.cc.
 
-class Instruction;
 class Interrupt;
 
+// The following class defines an instruction, represented in both
+// 	undecoded binary form
+//      decoded to identify
+//	    operation to do
+//	    registers to act on
+//	    any immediate operand value
+
+class Instruction {
+  public:
+    void Decode();	// decode the binary representation of the instruction
+
+    unsigned int value; // binary representation of the instruction
+
+    char opCode;     // Type of instruction.  This is NOT the same as the
+    		     // opcode field from the instruction: see defs in mips.h
+    char rs, rt, rd; // Three registers from instruction.
+    int extra;       // Immediate or target or shamt field or offset.
+                     // Immediates are sign-extended.
+};
+
 class Machine {
   public:
     Machine(bool debug);	// Initialize the simulation of the hardware
@@ -120,11 +152,11 @@ class Machine {
 // NOTE: the hardware translation of virtual addresses in the user program
 // to physical addresses (relative to the beginning of "mainMemory")
 // can be controlled by one of:
-//	a traditional linear page table
+//	a two-level page table (a directory of leaf tables)
 //  	a software-loaded translation lookaside buffer (tlb) -- a cache of 
 //	  mappings of virtual page #'s to physical page #'s
 //
-// If "tlb" is NULL, the linear page table is used
+// If "tlb" is NULL, the page table is used
 // If "tlb" is non-NULL, the Nachos kernel is responsible for managing
 //	the contents of the TLB.  But the kernel can use any data structure
 //	it wants (eg, segmented paging) for handling TLB cache misses.
@@ -134,23 +166,37 @@ class Machine {
 // space, stored in memory), there is only one TLB (implemented in hardware).
 // Thus the TLB pointer should be considered as *read-only*, although 
 // the contents of the TLB are free to be modified by the kernel software.
+//
+// The TLB is set-associative: "tlbSize" entries in sets of "tlbWays",
+// a page going in set (vpn % number of sets).  Entries are tagged with
+// the address space ID they belong to, so a context switch does not
+// flush it; an entry of a page that has been unmapped since is noticed
+// by looking at its page table entry, and treated as a miss.
     class TLBEntry {
     public:
       TLBEntry() {
         entry = NULL;
+        asid = -1;
+        virtualPage = -1;
         LastUpdateTime = 0;
         valid = FALSE;
       }
-      TranslationEntry *entry;
-      int LastUpdateTime;
+      int asid;				// address space of the mapping
+      int virtualPage;			// page number -- the tag
+      TranslationEntry *entry;		// its page table entry
+      int LastUpdateTime;		// when last used, for TLBLRU
       bool valid;
     };
 
     TLBEntry *tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
+    int tlbSize;		// number of entries
+    int tlbWays;		// entries per set
+    TLBPolicy tlbPolicy;	// how to pick the entry to replace
+    int currentAsid;		// address space ID of the running program
 
-    TranslationEntry *pageTable;
-    unsigned int pageTableSize;
+    TranslationEntry **pageDirectory;	// page table of the running program
+    unsigned int pageTableSize;		// pages it can hold
 
     bool ReadMem(int addr, int size, int* value);
     bool WriteMem(int addr, int size, int value);
@@ -159,9 +205,24 @@ class Machine {
 				// correct translation couldn't be found.
 
     //bool UpdateTLB(TranslationEntry* from, TranslationEntry* to);
-    void UpdateTLB(TranslationEntry* entry);
-    void DeleteTLB(TranslationEntry* entry);
+    void UpdateTLB(int vpn, TranslationEntry* entry);
+				// Load the mapping of page "vpn" of the
+				// running address space into the TLB
+
+    void InvalidateDecoded(int frame);
+				// Forget the decoded instructions of a
+				// physical page, because it was written
+				// or is about to hold another page
   private:
+    int tlbSets;		// tlbSize / tlbWays
+    int *tlbNext;		// next entry of each set, for TLBFIFO
+    bool useDecodeCache;	// keep decoded instructions around?
+    Instruction *decoded;	// decoded copy of each word of memory
+    bool *decodedValid;		// is the decoded copy of a word current?
+    bool *pageDecoded;		// does a physical page have any?
+    int tlbClock;		// counts TLB uses, for TLBLRU
+    TranslationEntry *LookupTLB(int vpn);
+				// The TLB's mapping of page "vpn", or NULL
 
 // Routines internal to the machine simulation -- DO NOT call these directly
     void DelayedLoad(int nextReg, int nextVal);  	
@@ -169,6 +230,10 @@ class Machine {
 
     void OneInstruction(Instruction *instr); 	
     				// Run one instruction of a user program.
+    bool FetchInstruction(Instruction *instr);
+				// Fetch and decode the instruction at the
+				// PC, through the decode cache.  Return
+				// FALSE if the fetch raised an exception
     
 
 
@@ -203,6 +268,9 @@ extern void ExceptionHandler(ExceptionType which);
 				// Entry point into Nachos for handling
 				// user system calls and exceptions
 				// Defined in exception.cc
+extern void PageDaemon();	// Body of the thread that keeps some
+				// physical pages free
+				// Defined in exception.cc
 
 
 
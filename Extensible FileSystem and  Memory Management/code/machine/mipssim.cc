@@ -24,26 +24,6 @@
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 
-// The following class defines an instruction, represented in both
-// 	undecoded binary form
-//      decoded to identify
-//	    operation to do
-//	    registers to act on
-//	    any immediate operand value
-
-class Instruction {
-  public:
-    void Decode();	// decode the binary representation of the instruction
-
-    unsigned int value; // binary representation of the instruction
-
-    char opCode;     // Type of instruction.  This is NOT the same as the
-    		     // opcode field from the instruction: see defs in mips.h
-    char rs, rt, rd; // Three registers from instruction.
-    int extra;       // Immediate or target or shamt field or offset.
-                     // Immediates are sign-extended.
-};
-
 //----------------------------------------------------------------------
 // Machine::Run
 // 	Simulate the execution of a user-level program on Nachos.
@@ -62,6 +42,9 @@ Machine::Run()
         cout << "Starting program in thread: " << kernel->currentThread->getName();
 	cout << ", at time: " << kernel->stats->totalTicks << "\n";
     }
+    if (kernel->stats->hostStart == 0) {	// for the MIPS rate
+      kernel->stats->hostStart = HostTime();
+    }
     kernel->interrupt->setStatus(UserMode);
     for (;;) {
         OneInstruction(instr);
@@ -124,16 +107,13 @@ Machine::OneInstruction(Instruction *instr)
     int byte;       // described in Kane for LWL,LWR,...
 #endif
 
-    int raw;
     int nextLoadReg = 0; 	
     int nextLoadValue = 0; 	// record delayed load operation, to apply
 				// in the future
 
     // Fetch instruction 
-    if (!ReadMem(registers[PCReg], 4, &raw))
+    if (!FetchInstruction(instr))
 	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
 
     if (debug->IsEnabled('m')) {
         struct OpString *str = &opStrings[instr->opCode];
@@ -700,6 +680,75 @@ Machine::OneInstruction(Instruction *instr)
     registers[NextPCReg] = pcAfter;
 }
 
+//----------------------------------------------------------------------
+// Machine::FetchInstruction
+// 	Fetch the instruction at the PC and decode it into "instr".
+//	Return FALSE if the translation of the PC raised an exception.
+//
+//	Decoding is the same every time a word is executed, so the
+//	decoded form of each word of physical memory is kept, and a
+//	loop only pays for Decode() on its first trip.  The PC is still
+//	translated every time: the cache is by physical address, so
+//	page faults, protection and the use bits all work as before.
+//	A decoded word stays good until its page is written, or is
+//	given to another virtual page (see InvalidateDecoded).
+//----------------------------------------------------------------------
+
+bool
+Machine::FetchInstruction(Instruction *instr)
+{
+    ExceptionType exception;
+    int physicalAddress;
+    int word;
+
+    if (!useDecodeCache) {
+      int raw;
+
+      if (!ReadMem(registers[PCReg], 4, &raw))
+	return FALSE;
+      instr->value = raw;
+      instr->Decode();
+      return TRUE;
+    }
+
+    exception = Translate(registers[PCReg], &physicalAddress, 4, FALSE);
+    if (exception != NoException) {
+      RaiseException(exception, registers[PCReg]);
+      return FALSE;
+    }
+    word = physicalAddress / 4;
+    if (decodedValid[word]) {
+      *instr = decoded[word];
+      kernel->stats->numDecodeHits++;
+      return TRUE;
+    }
+    instr->value = WordToHost(*(unsigned int *) &mainMemory[physicalAddress]);
+    instr->Decode();
+    decoded[word] = *instr;
+    decodedValid[word] = TRUE;
+    pageDecoded[physicalAddress / PageSize] = TRUE;
+    kernel->stats->numDecodeMisses++;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateDecoded
+// 	Drop the decoded instructions of physical page "frame".  Called
+//	on a write to the page, and by the kernel whenever it hands the
+//	page to a different virtual page.
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecoded(int frame)
+{
+    if (!useDecodeCache || !pageDecoded[frame])
+      return;
+    for (int i = frame * PageSize / 4; i < (frame + 1) * PageSize / 4; i++) {
+      decodedValid[i] = FALSE;
+    }
+    pageDecoded[frame] = FALSE;
+}
+
 //----------------------------------------------------------------------
 // Machine::DelayedLoad
 // 	Simulate effects of a delayed load.
@@ -22,7 +22,66 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
-    memRefNum = numTLBHit = numTLBMiss = 0;
+    memRefNum = numTLBHit = numTLBMiss = numPageHit = 0;
+    tlbHitsByProcess = new map<int, int>();
+    tlbMissesByProcess = new map<int, int>();
+    pagePolicy = NULL;
+    numPageEvictions = numSwapWrites = numSwapWritesSaved = 0;
+    numSwapSlotsInUse = maxSwapSlotsInUse = 0;
+    numSwapReads = numFilePageIns = numZeroFills = numSharedCodeHits = 0;
+    numClusterReads = numPrefetchedPages = numPrefetchHits = 0;
+    numDaemonEvictions = faultTicks = numTimedFaults = maxFaultTicks = 0;
+    for (int i = 0; i < NumLatencyBuckets; i++) {
+      faultLatency[i] = 0;
+    }
+    numForkedPages = numCopyOnWriteFaults = numCopyOnWriteCopies = 0;
+    numCacheHits = numCacheMisses = 0;
+    numDecodeHits = numDecodeMisses = 0;
+    hostStart = 0;
+    reportMips = FALSE;
+    numReadAheads = numReadAheadHits = 0;
+    diskPolicy = NULL;
+    numDiskRequests = numDiskSectors = diskQueueTicks = diskServiceTicks = maxDiskWait = 0;
+}
+
+//----------------------------------------------------------------------
+// Statistics::TLBAccess
+// 	Count a TLB lookup by process "pid", in total and per process.
+//----------------------------------------------------------------------
+
+void
+Statistics::TLBAccess(int pid, bool hit)
+{
+    if (hit) {
+      numTLBHit++;
+      (*tlbHitsByProcess)[pid]++;
+    }
+    else {
+      numTLBMiss++;
+      (*tlbMissesByProcess)[pid]++;
+    }
+}
+
+//----------------------------------------------------------------------
+// Statistics::FaultLatency
+// 	Count a page fault that took "ticks", from the exception to the
+//	page being mapped, in the latency histogram.
+//----------------------------------------------------------------------
+
+void
+Statistics::FaultLatency(int ticks)
+{
+    int bucket = 0;
+
+    while (bucket < NumLatencyBuckets - 1 && (ticks >> (bucket + 1)) > 0) {
+      bucket++;
+    }
+    faultLatency[bucket]++;
+    faultTicks += ticks;
+    numTimedFaults++;
+    if (ticks > maxFaultTicks) {
+      maxFaultTicks = ticks;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -36,20 +95,79 @@ Statistics::Print()
 {
     cout << "Ticks: total " << totalTicks << ", idle " << idleTicks;
 		cout << ", system " << systemTicks << ", user " << userTicks <<"\n";
-    //cout << "Disk I/O: reads " << numDiskReads;
-		//cout << ", writes " << numDiskWrites << "\n";
+    cout << "Decode cache: hits " << numDecodeHits << " misses " << numDecodeMisses;
+    if (numDecodeHits + numDecodeMisses > 0) {
+      cout << " hit rate " << (double)numDecodeHits / (double)(numDecodeMisses + numDecodeHits);
+    }
+    cout << "\n";
+    if (reportMips && hostStart > 0) {
+      double seconds = HostTime() - hostStart;
+
+      cout << "Simulation: " << userTicks << " instructions in " << seconds;
+      cout << " s, " << (double)userTicks / seconds / 1000000 << " MIPS\n";
+    }
+    cout << "Disk I/O: reads " << numDiskReads;
+    cout << ", writes " << numDiskWrites << "\n";
+    cout << "Sector cache: hits " << numCacheHits << " misses " << numCacheMisses;
+    if (numCacheHits + numCacheMisses > 0) {
+      cout << " hit rate " << (double)numCacheHits / (double)(numCacheMisses + numCacheHits);
+    }
+    cout << "\n";
+    if (numDiskRequests > 0) {
+      cout << "Disk scheduling (" << diskPolicy << "): requests " << numDiskRequests;
+      cout << ", sectors " << numDiskSectors;
+      cout << ", avg queue " << diskQueueTicks / numDiskRequests;
+      cout << ", avg service " << diskServiceTicks / numDiskRequests;
+      cout << ", max wait " << maxDiskWait;
+      cout << ", per 1M ticks " << (double)numDiskRequests * 1000000 / (double)totalTicks << "\n";
+    }
+    cout << "Read-ahead: prefetched " << numReadAheads << " hits " << numReadAheadHits;
+    if (numReadAheads > 0) {
+      cout << " accuracy " << (double)numReadAheadHits / (double)numReadAheads;
+    }
+    cout << "\n";
 		//cout << "Console I/O: reads " << numConsoleCharsRead;
     //cout << ", writes " << numConsoleCharsWritten << "\n";
-    cout << "Paging: hits " << numPageHit << " faults " << numPageFaults;
+    cout << "Paging";
+    if (pagePolicy != NULL) {
+      cout << " (" << pagePolicy << ")";
+    }
+    cout << ": hits " << numPageHit << " faults " << numPageFaults;
+    cout << " evictions " << numPageEvictions;
     if (numPageHit + numPageFaults > 0) {
       cout << " hit rate " << (double)numPageHit / (double)(numPageFaults + numPageHit);
+      cout << " fault rate " << (double)numPageFaults / (double)(numPageFaults + numPageHit);
     }
     cout << "\n";
+    cout << "Swap: writes " << numSwapWrites << " avoided " << numSwapWritesSaved;
+    cout << ", slots in use " << numSwapSlotsInUse << " peak " << maxSwapSlotsInUse << "\n";
+    cout << "Page-ins: from swap " << numSwapReads << " from file " << numFilePageIns;
+    cout << " zero-filled " << numZeroFills << " shared code " << numSharedCodeHits << "\n";
+    cout << "Fault-around: clustered reads " << numClusterReads << ", pages prefetched ";
+    cout << numPrefetchedPages << " used " << numPrefetchHits << "\n";
+    cout << "Page daemon: evictions " << numDaemonEvictions << "\n";
+    if (numTimedFaults > 0) {
+      cout << "Fault latency: avg " << faultTicks / numTimedFaults;
+      cout << " max " << maxFaultTicks << " ticks\n";
+      for (int i = 0; i < NumLatencyBuckets; i++) {
+        if (faultLatency[i] > 0) {
+          cout << "  < " << (2 << i) << " ticks: " << faultLatency[i] << "\n";
+        }
+      }
+    }
+    cout << "Fork: pages shared " << numForkedPages << ", copy-on-write faults ";
+    cout << numCopyOnWriteFaults << " copies " << numCopyOnWriteCopies << "\n";
     cout << "TLB: hits " << numTLBHit << " misses " << numTLBMiss;
     if (numTLBHit + numTLBMiss > 0) {
       cout << " hit rate " << (double)numTLBHit / (double)(numTLBMiss + numTLBHit);
     }
     cout << "\n";
+    map<int, int>::iterator iter;
+    for (iter = tlbMissesByProcess->begin(); iter != tlbMissesByProcess->end(); iter++) {
+      int hits = (*tlbHitsByProcess)[iter->first];
+      cout << "TLB pid " << iter->first << ": hits " << hits << " misses " << iter->second;
+      cout << " hit rate " << (double)hits / (double)(hits + iter->second) << "\n";
+    }
     //cout << "Network I/O: packets received " << numPacketsRecvd;
 		//cout << ", sent " << numPacketsSent << "\n";
 }
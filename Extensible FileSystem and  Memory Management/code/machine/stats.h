@@ -12,6 +12,13 @@
 #define STATS_H
 
 #include "copyright.h"
+#include <map>
+
+using namespace std;
+
+#define NumLatencyBuckets	24	// fault latency histogram buckets;
+					// bucket i counts faults that took
+					// [2^i, 2^(i+1)) ticks (bucket 0: < 2)
 
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
@@ -39,10 +46,50 @@ class Statistics {
     Statistics(); 		// initialize everything to zero
 
     void Print();		// print collected statistics
+    void TLBAccess(int pid, bool hit); // count a TLB hit or miss
+    void FaultLatency(int ticks);	// count a page fault that took "ticks"
     int numPageHit;
     int memRefNum;
     int numTLBHit;
     int numTLBMiss;
+    map<int, int> *tlbHitsByProcess;	// pid -> TLB hits
+    map<int, int> *tlbMissesByProcess;	// pid -> TLB misses
+    char *pagePolicy;		// page replacement policy in use
+    int numPageEvictions;	// pages evicted to make room
+    int numSwapWrites;		// evicted pages written to swap
+    int numSwapWritesSaved;	// clean evicted pages, not written
+    int numSwapReads;		// faulted pages read back from swap
+    int numFilePageIns;		// faulted pages read from the program file
+    int numZeroFills;		// faulted pages that were just zeroed
+    int numSharedCodeHits;	// faulted code pages another run of the
+				// program already had in memory
+    int numClusterReads;	// swap reads that brought in neighbours
+    int numPrefetchedPages;	// neighbours read in by fault-around
+    int numPrefetchHits;	// of those, how many were then used
+    int numForkedPages;		// pages shared copy-on-write by Fork
+    int numCopyOnWriteFaults;	// writes to pages shared since a fork
+    int numCopyOnWriteCopies;	// of those, how many copied the page
+    int numDaemonEvictions;	// pages evicted by the page daemon
+    int faultLatency[NumLatencyBuckets]; // page faults by time taken
+    int faultTicks;		// total time spent on page faults
+    int numTimedFaults;		// page faults timed
+    int maxFaultTicks;		// longest page fault
+    int numSwapSlotsInUse;	// swap slots held by address spaces
+    int maxSwapSlotsInUse;	// most ever held at once
+    int numDecodeHits;		// instructions fetched already decoded
+    int numDecodeMisses;	// instructions that had to be decoded
+    double hostStart;		// host time user code began, 0 if not yet
+    bool reportMips;		// print the simulated MIPS rate?
+    int numCacheHits;		// sector reads served by the buffer cache
+    int numCacheMisses;		// sector reads that had to go to disk
+    int numReadAheads;		// sectors read ahead into the cache
+    int numReadAheadHits;	// of those, how many were then read
+    char *diskPolicy;		// disk scheduling policy in use
+    int numDiskRequests;	// requests completed by SynchDisk
+    int numDiskSectors;		// sectors moved by those requests
+    int diskQueueTicks;		// total time requests spent queued
+    int diskServiceTicks;	// total time requests spent on the disk
+    int maxDiskWait;		// longest queue + service time
 };
 
 // Constants used to reflect the relative time an operation would
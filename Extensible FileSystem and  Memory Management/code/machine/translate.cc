@@ -6,8 +6,10 @@
 //
 // Two types of translation are supported here.
 //
-//	Linear page table -- the virtual page # is used as an index
-//	into the table, to find the physical page #.
+//	Two-level page table -- the high bits of the virtual page #
+//	pick a leaf table from the page directory, and the low bits
+//	index the leaf, to find the physical page #.  Leaves that
+//	would be empty are not allocated.
 //
 //	Translation lookaside buffer -- associative lookup in the table
 //	to find an entry with the same virtual page #.  If found,
@@ -145,6 +147,7 @@ Machine::WriteMem(int addr, int size, int value)
 	RaiseException(exception, addr);
 	return FALSE;
     }
+    InvalidateDecoded(physicalAddress / PageSize);	// self-modifying code
     switch (size) {
       case 1:
 	mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
@@ -184,7 +187,6 @@ Machine::WriteMem(int addr, int size, int value)
 ExceptionType
 Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 {
-    int i;
     unsigned int vpn, offset;
     TranslationEntry *entry = NULL;
     unsigned int pageFrame;
@@ -199,40 +201,36 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     }
     
     // we must have either a TLB or a page table, but not both!
-    //ASSERT(tlb == NULL || pageTable == NULL);	
-    //ASSERT(tlb != NULL || pageTable != NULL);	
+    //ASSERT(tlb == NULL || pageDirectory == NULL);	
+    //ASSERT(tlb != NULL || pageDirectory != NULL);	
 
 // calculate the virtual page number, and offset within the page,
 // from the virtual address
     vpn = (unsigned) virtAddr / PageSize;
     offset = (unsigned) virtAddr % PageSize;
 
-    if (kernel->useTLB == TRUE) {
-      for (entry = NULL, i = 0; i < TLBSize; i++) {
-        if (tlb[i].valid == TRUE) {
-          if(tlb[i].entry->virtualPage == ((int)vpn)){
-            entry = tlb[i].entry;			// FOUND!
-            kernel->stats->numTLBHit++;
-            isInTLB = TRUE;
-            break;
-          }
-        }
-      }
+    // check tlb first
+    if (tlb != NULL) {
+      entry = LookupTLB(vpn);
+      isInTLB = (entry != NULL);
+      kernel->stats->TLBAccess(kernel->currentThread->pid, isInTLB);
     }
 
-    // check tlb first
+    if (entry == NULL) { // not in tlb, walk the page table
+      TranslationEntry *leaf = NULL;
 
-    if (entry == NULL) { // not in tlb, check for memory
-      kernel->stats->numTLBMiss++;
-      if (vpn >= pageTableSize) {
+      if (vpn < pageTableSize) {
+        leaf = pageDirectory[vpn / PageLeafSize];
+      }
+      if (leaf == NULL) {
         DEBUG(dbgAddr, "Illegal virtual page # " << virtAddr);
         return AddressErrorException;
       }
-      else if (!pageTable[vpn].valid) {
+      entry = &leaf[vpn % PageLeafSize];
+      if (!entry->valid) {
         DEBUG(dbgAddr, "Invalid virtual page # " << virtAddr);
         return PageFaultException;
       }
-      entry = &pageTable[vpn];
     }
 
     if (entry->readOnly && writing) {	// trying to write to a read-only page
@@ -256,68 +254,106 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     DEBUG(dbgAddr, "phys addr = " << *physAddr);
 
     kernel->stats->numPageHit++; 
-    if (kernel->isRandom != TRUE) {
-      kernel->EntryCache->set(kernel->stats->totalTicks, entry); // update the cache
+    // the replacement policy tracks physical pages, however many
+    // address spaces share them
+    if (kernel->pagePolicy == PageLRU) {
+      kernel->EntryCache->touch(pageFrame); // ordered at the next sweep
+    }
+    else {
+      kernel->coreMap[pageFrame].referenced = TRUE;
+    }
+    if (writing) {
+      kernel->coreMap[pageFrame].dirty = TRUE;
     }
 
-    if (kernel->useTLB == TRUE) {
-      UpdateTLB(entry);
+    if (tlb != NULL && !isInTLB) {
+      UpdateTLB(vpn, entry);
     }
     return NoException;
 }
 
-void Machine::UpdateTLB(TranslationEntry *entry) {
-  if (entry == NULL) { // add tlb entry
-    DEBUG(dbgSys, "error update");
-    return;
-  }
+//----------------------------------------------------------------------
+// Machine::LookupTLB
+// 	Return the page table entry the TLB holds for page "vpn" of the
+//	running address space, or NULL on a miss.  Only the set the page
+//	maps to is searched.
+//
+//	The page may have been evicted since the TLB entry was loaded;
+//	the page table entry says so, and the TLB entry is dropped.
+//	(If the page is back in memory, the page table entry already
+//	says where, so the TLB entry is still good.)
+//----------------------------------------------------------------------
 
-  bool isDone = FALSE;
+TranslationEntry *
+Machine::LookupTLB(int vpn)
+{
+    TLBEntry *set = &tlb[(vpn % tlbSets) * tlbWays];
 
-  for (int i = 0; i < TLBSize; i++) { // exist, update ticks
-    if (tlb[i].valid == TRUE && tlb[i].entry == entry) {
-      tlb[i].LastUpdateTime = kernel->stats->totalTicks;
-      isDone = TRUE;
-      DEBUG(dbgSys, "[" << i <<"] virtual #" << entry->virtualPage << " phy #" << entry->physicalPage << " is updated.");
-      break;
+    for (int i = 0; i < tlbWays; i++) {
+      if (set[i].valid && set[i].asid == currentAsid && set[i].virtualPage == vpn) {
+        if (!set[i].entry->valid) {
+          set[i].valid = FALSE;
+          return NULL;
+        }
+        set[i].LastUpdateTime = ++tlbClock;
+        return set[i].entry;			// FOUND!
+      }
     }
-  }
-
-  if (isDone == FALSE) { // add to tlb
-    for (int i = 0; i < TLBSize; i++) {
-      if (tlb[i].valid == FALSE) {
-        tlb[i].entry = entry;
-        tlb[i].valid = TRUE;
-        tlb[i].LastUpdateTime = kernel->stats->totalTicks;
-        isDone = TRUE;
-        DEBUG(dbgSys, "[" << i << "] virtual #" << entry->virtualPage << " phy #" << entry->physicalPage << " is added to TLB");
-        break;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// Machine::UpdateTLB
+// 	Load the mapping of page "vpn" of the running address space,
+//	"entry", into its TLB set.  A free entry of the set is used if
+//	there is one; otherwise tlbPolicy picks the one to replace.
+//	Entries of address spaces that have gone away are never matched
+//	again, and are replaced like any other.
+//----------------------------------------------------------------------
+
+void
+Machine::UpdateTLB(int vpn, TranslationEntry *entry)
+{
+    int setNum = vpn % tlbSets;
+    TLBEntry *set = &tlb[setNum * tlbWays];
+    int victim = -1;
+
+    for (int i = 0; i < tlbWays && victim == -1; i++) { // already there
+      if (set[i].valid && set[i].asid == currentAsid && set[i].virtualPage == vpn) {
+        victim = i;
       }
     }
-  }
-
-  if (isDone == FALSE) { // swap
-    int minTicks = INT_MAX;
-    int minIndex = 0;
-    for (int i = 0; i < TLBSize; i++) {
-      if (tlb[i].LastUpdateTime < minTicks) {
-        minIndex = i;
-        minTicks = tlb[i].LastUpdateTime;
+    for (int i = 0; i < tlbWays && victim == -1; i++) {
+      if (!set[i].valid) {
+        victim = i;
       }
     }
-    DEBUG(dbgSys, "[" << minIndex << "] TLB Miss, swap from virtual #" << tlb[minIndex].entry->virtualPage << " phy #" << tlb[minIndex].entry->physicalPage << " to virtual #"
-          << entry->virtualPage << " phy #" << entry->physicalPage << " Last Update Ticks:" << minTicks);
-    // swap tlb
-    tlb[minIndex].entry = entry;
-    tlb[minIndex].LastUpdateTime = kernel->stats->totalTicks;
-  }
-}
-
-void Machine::DeleteTLB(TranslationEntry* entry) {
-  for (int i = 0; i < TLBSize; i++) {
-    if (tlb[i].entry == entry) {
-      tlb[i].valid = FALSE;
-      DEBUG(dbgSys, "[" << i << "] virtual #" << entry->virtualPage << " phy #" << entry->physicalPage << " is added from TLB");
+    if (victim == -1) {
+      switch (tlbPolicy) {
+        case TLBFIFO:
+          victim = tlbNext[setNum];
+          tlbNext[setNum] = (victim + 1) % tlbWays;
+          break;
+        case TLBRandom:
+          victim = RandomNumber() % tlbWays;
+          break;
+        case TLBLRU:
+        default:
+          victim = 0;
+          for (int i = 1; i < tlbWays; i++) {
+            if (set[i].LastUpdateTime < set[victim].LastUpdateTime) {
+              victim = i;
+            }
+          }
+          break;
+      }
+      DEBUG(dbgAddr, "TLB set " << setNum << " replaces page " << set[victim].virtualPage
+            << " of space " << set[victim].asid << " by page " << vpn);
     }
-  }
-}
\ No newline at end of file
+
+    set[victim].asid = currentAsid;
+    set[victim].virtualPage = vpn;
+    set[victim].entry = entry;
+    set[victim].LastUpdateTime = ++tlbClock;
+    set[victim].valid = TRUE;
+}
@@ -0,0 +1,46 @@
+/* forkcow.c
+ *	Benchmark for copy-on-write SysFork.
+ *
+ *	The parent fills an array, then forks NCHILD children.  Child k
+ *	writes to k/(NCHILD-1) of the array's pages before exiting, so
+ *	the first child writes nothing and the last writes everything.
+ *	Each child reads "touch" as it was when it was forked, even
+ *	though the parent has changed it since.
+ *
+ *	Compare the "Fork:" line of the statistics printed when Nachos
+ *	halts with the number of pages the children wrote.
+ */
+
+#include "syscall.h"
+
+#define NCHILD		4
+#define PAGES		32	/* size of the array, in pages */
+#define PAGEWORDS	32	/* PageSize / sizeof(int) */
+
+int data[PAGES * PAGEWORDS];
+int touch;			/* pages the next child writes */
+
+void
+Child()
+{
+    int i;
+
+    for (i = 0; i < touch; i++)
+	data[i * PAGEWORDS]++;
+    Exit(0);
+}
+
+int
+main()
+{
+    int i;
+
+    for (i = 0; i < PAGES * PAGEWORDS; i++)	/* make every page resident */
+	data[i] = i;
+
+    for (i = 0; i < NCHILD; i++) {
+	touch = i * PAGES / (NCHILD - 1);
+	SysFork(Child);
+    }
+    Exit(0);		/* the children keep the pages they share */
+}
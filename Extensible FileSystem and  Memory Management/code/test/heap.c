@@ -0,0 +1,45 @@
+/* heap.c
+ *	Test program for Sbrk and the two-level page table.
+ *
+ *	Grows the heap a chunk at a time, writes to every page of each
+ *	chunk, and checks that the pages read back what was written and
+ *	that fresh heap memory starts out zero.  The heap lies far below
+ *	the stack, which is at the top of the address space, so only
+ *	the page table leaves it actually uses are allocated.
+ *
+ *	Exits with the number of pages that were wrong, 0 on success.
+ */
+
+#include "syscall.h"
+
+#define CHUNKS		8
+#define CHUNKSIZE	2048	/* bytes per Sbrk */
+#define PAGEWORDS	32	/* PageSize / sizeof(int) */
+
+int *chunk[CHUNKS];
+
+int
+main()
+{
+    int i, j, bad = 0;
+
+    for (i = 0; i < CHUNKS; i++) {
+	chunk[i] = (int *) Sbrk(CHUNKSIZE);
+	if ((int) chunk[i] == -1)
+	    Exit(-1);
+	for (j = 0; j < CHUNKSIZE / sizeof(int); j += PAGEWORDS) {
+	    if (chunk[i][j] != 0)
+		bad++;
+	    chunk[i][j] = i * 1000 + j;
+	}
+    }
+
+    for (i = 0; i < CHUNKS; i++)
+	for (j = 0; j < CHUNKSIZE / sizeof(int); j += PAGEWORDS)
+	    if (chunk[i][j] != i * 1000 + j)
+		bad++;
+
+    if (Sbrk(-1) != -1)			/* the heap cannot shrink */
+	bad++;
+    Exit(bad);
+}
@@ -41,6 +41,10 @@ Alarm::Alarm(bool doRandom)
 //
 //	For now, just provide time-slicing.  Only need to time slice 
 //      if we're currently running something (in other words, not idle).
+//
+//	With LRU page replacement, this is also when the physical pages
+//	referenced since the last tick are moved to the front of the
+//	LRU list.
 //----------------------------------------------------------------------
 
 void 
@@ -49,6 +53,9 @@ Alarm::CallBack()
     Interrupt *interrupt = kernel->interrupt;
     MachineStatus status = interrupt->getStatus();
     
+    if (kernel->pagePolicy == PageLRU) {
+	kernel->EntryCache->sweep(kernel->stats->totalTicks);
+    }
     if (status != IdleMode) {
 	interrupt->YieldOnReturn();
     }
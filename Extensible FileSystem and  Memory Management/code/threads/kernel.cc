@@ -16,7 +16,9 @@
 #include "string.h"
 #include "synchconsole.h"
 #include "synchdisk.h"
+#include "sectorcache.h"
 #include "post.h"
+#include "directory.h"
 
 //----------------------------------------------------------------------
 // Kernel::Kernel
@@ -30,6 +32,18 @@ Kernel::Kernel(int argc, char **argv)
     debugUserProg = FALSE;
     consoleIn = NULL;          // default is stdin
     consoleOut = NULL;         // default is stdout
+    cacheSectors = DefaultCacheSectors;
+    pagePolicy = PageLRU;
+    diskPolicy = "clook";
+    tlbSize = TLBSize;
+    tlbWays = TLBSize;		// fully associative
+    tlbPolicy = TLBLRU;
+    nextAsid = 0;
+    faultAround = DefaultFaultAround;
+    freeLow = DefaultFreeLow;
+    freeHigh = DefaultFreeHigh;
+    decodeCache = TRUE;
+    reportMips = FALSE;
 
     ProcessTable = new map<int, Thread*>();
 #ifndef FILESYS_STUB
@@ -55,6 +69,62 @@ Kernel::Kernel(int argc, char **argv)
 	    ASSERT(i + 1 < argc);
 	    consoleOut = argv[i + 1];
 	    i++;
+	} else if (strcmp(argv[i], "-bc") == 0) {
+	    ASSERT(i + 1 < argc);   // next argument is int
+	    cacheSectors = atoi(argv[i + 1]);
+	    ASSERT(cacheSectors > 0);
+	    i++;
+	} else if (strcmp(argv[i], "-pr") == 0) {
+	    ASSERT(i + 1 < argc);   // lru, random or clock
+	    if (strcmp(argv[i + 1], "random") == 0) {
+		pagePolicy = PageRandom;
+	    } else if (strcmp(argv[i + 1], "clock") == 0) {
+		pagePolicy = PageClock;
+	    } else {
+		ASSERT(strcmp(argv[i + 1], "lru") == 0);
+		pagePolicy = PageLRU;
+	    }
+	    i++;
+	} else if (strcmp(argv[i], "-ts") == 0) {
+	    ASSERT(i + 1 < argc);   // next argument is int
+	    tlbSize = atoi(argv[i + 1]);
+	    ASSERT(tlbSize > 0);
+	    i++;
+	} else if (strcmp(argv[i], "-ta") == 0) {
+	    ASSERT(i + 1 < argc);   // next argument is int
+	    tlbWays = atoi(argv[i + 1]);
+	    ASSERT(tlbWays > 0);
+	    i++;
+	} else if (strcmp(argv[i], "-tr") == 0) {
+	    ASSERT(i + 1 < argc);   // lru, fifo or random
+	    if (strcmp(argv[i + 1], "fifo") == 0) {
+		tlbPolicy = TLBFIFO;
+	    } else if (strcmp(argv[i + 1], "random") == 0) {
+		tlbPolicy = TLBRandom;
+	    } else {
+		ASSERT(strcmp(argv[i + 1], "lru") == 0);
+		tlbPolicy = TLBLRU;
+	    }
+	    i++;
+	} else if (strcmp(argv[i], "-fa") == 0) {
+	    ASSERT(i + 1 < argc);   // next argument is int
+	    faultAround = atoi(argv[i + 1]);
+	    ASSERT(faultAround >= 0 && faultAround <= MaxFaultAround);
+	    i++;
+	} else if (strcmp(argv[i], "-wm") == 0) {
+	    ASSERT(i + 2 < argc);   // next two arguments are ints
+	    freeLow = atoi(argv[i + 1]);
+	    freeHigh = atoi(argv[i + 2]);
+	    ASSERT(freeLow >= 0 && freeLow <= freeHigh && freeHigh <= NumPhysPages);
+	    i += 2;
+	} else if (strcmp(argv[i], "-nd") == 0) {
+	    decodeCache = FALSE;
+	} else if (strcmp(argv[i], "-mips") == 0) {
+	    reportMips = TRUE;
+	} else if (strcmp(argv[i], "-ds") == 0) {
+	    ASSERT(i + 1 < argc);   // fifo, sstf, clook or deadline
+	    diskPolicy = argv[i + 1];
+	    i++;
 #ifndef FILESYS_STUB
 	} else if (strcmp(argv[i], "-f") == 0) {
 	    formatFlag = TRUE;
@@ -75,6 +145,13 @@ Kernel::Kernel(int argc, char **argv)
 	    cout << "Partial usage: nachos [-nf]\n";
 #endif
             cout << "Partial usage: nachos [-n #] [-m #]\n";
+            cout << "Partial usage: nachos [-bc cacheSectors]\n";
+            cout << "Partial usage: nachos [-ds fifo|sstf|clook|deadline]\n";
+            cout << "Partial usage: nachos [-pr lru|random|clock]\n";
+            cout << "Partial usage: nachos [-ts tlbSize] [-ta tlbWays] [-tr lru|fifo|random]\n";
+            cout << "Partial usage: nachos [-fa faultAroundPages]\n";
+            cout << "Partial usage: nachos [-wm freeLow freeHigh]\n";
+            cout << "Partial usage: nachos [-nd] [-mips]\n";
 	}
     }
 }
@@ -90,7 +167,9 @@ void
 Kernel::Initialize(int q, bool israndom, bool usetlb)
 {
     quantum = q;
-    isRandom = israndom; // set if random pick page
+    if (israndom) {
+      pagePolicy = PageRandom; // -R: randomly pick page
+    }
     useTLB = usetlb;
     // We didn't explicitly allocate the current thread we are running in.
     // But if it ever tries to give up the CPU, we better have a Thread
@@ -99,13 +178,17 @@ Kernel::Initialize(int q, bool israndom, bool usetlb)
     currentThread->setStatus(RUNNING);
 
     stats = new Statistics();		// collect statistics
+    stats->reportMips = reportMips;
     interrupt = new Interrupt;		// start up interrupt handling
     scheduler = new Scheduler();	// initialize the ready queue
+    EntryCache = new LRUCache(NumPhysPages); // before the alarm, which
+					// sweeps it on every tick
     alarm = new Alarm(randomSlice);	// start up time slicing
     machine = new Machine(debugUserProg);
     synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
     synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
-    synchDisk = new SynchDisk();   
+    synchDisk = new SynchDisk(SynchDisk::ParsePolicy(diskPolicy));   
+    sectorCache = new SectorCache(synchDisk, cacheSectors);
     locks = new Locks();
 
     readCount = new map<string, int>(); // record readers count for each file
@@ -147,15 +230,59 @@ Kernel::Initialize(int q, bool israndom, bool usetlb)
 
     swapSpace = fileSystem->Open("swapspace");
     cout << "File: [" << "/swapspace" << "] opened.\n";
+    if (swapSpace->Length() < NumSwapSlots * PageSize) {
+      // allocate all of swap now, so that writing out an evicted page
+      // never finds the disk full
+      int start = swapSpace->Length();
+      int size = NumSwapSlots * PageSize - start;
+      char *zeros = new char[size];
+
+      bzero(zeros, size);
+      if (swapSpace->WriteAt(zeros, size, start) != size || !swapSpace->Sync()) {
+        cerr << "Not enough disk space for " << NumSwapSlots << " swap slots\n";
+        ASSERT(FALSE);
+      }
+      delete [] zeros;
+    }
     insertFileToTable(swapSpace);
 
 
-    swapCounter = 0;
+    swapMap = new Bitmap(NumSwapSlots);
+    swapFilled = new Bitmap(NumSwapSlots);
+    swapRefs = new int[NumSwapSlots];
+    for (int i = 0; i < NumSwapSlots; i++) {
+      swapRefs[i] = 0;
+    }
     // initialize data structure
     freeMap = new Bitmap(NumPhysPages);
-    EntryCache = new LRUCache(NumPhysPages);
-    TLBCache = new LRUCache(TLBSize);
-    FIFO = new List<TranslationEntry *>();
+    coreMap = new CoreMapEntry[NumPhysPages];
+    codePages = new map<pair<int, int>, int>();
+    for (int i = 0; i < NumPhysPages; i++) {
+      coreMap[i].owners = new List<AddrSpace *>();
+      coreMap[i].vpn = -1;
+      coreMap[i].pinCount = 0;
+      coreMap[i].dirty = FALSE;
+      coreMap[i].referenced = FALSE;
+      coreMap[i].codePage = make_pair(-1, -1);
+    }
+    clockHand = 0;
+    pagingLock = new Lock("paging");
+    pageDaemonWake = new Semaphore("page daemon", 0);
+    pageDaemonAwake = FALSE;
+    if (freeHigh > 0) {
+      Thread *t = new Thread("page daemon");
+      t->Fork((VoidFunctionPtr) PageDaemon, (void *) NULL);
+    }
+    if (pagePolicy == PageRandom && !randomSlice) {
+      RandomInit((unsigned) time(0)); // seed once, not on every fault
+    }
+    if (pagePolicy == PageRandom) {
+      stats->pagePolicy = "random";
+    } else if (pagePolicy == PageClock) {
+      stats->pagePolicy = "clock";
+    } else {
+      stats->pagePolicy = "lru";
+    }
     ThreadId = 1;
     interrupt->Enable();
 
@@ -168,7 +295,17 @@ Kernel::Initialize(int q, bool israndom, bool usetlb)
 
 Kernel::~Kernel()
 {
+    map<int, OpenFile*>::iterator it;
 
+    // files left open still have delayed writes in memory
+    for (it = openFileTable->begin(); it != openFileTable->end(); it++) {
+	if (!it->second->Sync()) {
+	    cerr << "No room on disk for data written to "
+		 << it->second->getFullName() << "\n";
+	}
+    }
+    delete fileSystem;		// flushes the sector cache, so it must
+    delete sectorCache;		// go while the disk and interrupts still work
     delete stats;
     delete interrupt;
     delete scheduler;
@@ -177,14 +314,19 @@ Kernel::~Kernel()
     delete synchConsoleIn;
     delete synchConsoleOut;
     delete synchDisk;
-    delete fileSystem;
     delete postOfficeIn;
     delete postOfficeOut;
     delete freeMap;
+    delete swapMap;
+    delete swapFilled;
+    delete [] swapRefs;
     delete EntryCache;
-    delete FIFO;
+    for (int i = 0; i < NumPhysPages; i++) {
+      delete coreMap[i].owners;
+    }
+    delete [] coreMap;
+    delete codePages;
     delete ProcessTable;
-    delete TLBCache;
     delete pendingDeleteFiles;
     delete locks;
     delete readCount;
@@ -301,6 +443,91 @@ Kernel::NetworkTest() {
     // Then we're done!
 }
 
+//----------------------------------------------------------------------
+// LinearFind
+//      Look a name up by scanning the whole directory table, the way
+//	Directory::Find used to.  The baseline for DirectoryBenchmark.
+//----------------------------------------------------------------------
+
+static int
+LinearFind(Directory *directory, char *name)
+{
+    DirectoryEntry *table = directory->getEntry();
+
+    for (int i = 0; i < directory->getSize(); i++)
+        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
+	    return table[i].sector;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// DirectoryBenchmark
+//      Create 10000 files in one directory, look every one of them up,
+//	then remove them all.  Lookups are timed both through the hashed
+//	directory and by scanning the table.
+//
+//	The directory is kept in memory: the Nachos disk only has room
+//	for NumInode file headers, far fewer than 10000.
+//----------------------------------------------------------------------
+
+static void
+DirectoryBenchmark()
+{
+    const int numFiles = 10000;
+    Directory *directory = new Directory(16384);
+    char name[FileNameMaxLen + 1];
+    double start, addTime, findTime, scanTime, removeTime;
+
+    start = HostTime();
+    for (int i = 0; i < numFiles; i++) {
+	sprintf(name, "f%d", i);
+	ASSERT(directory->Add(name, i));
+    }
+    addTime = HostTime() - start;
+
+    start = HostTime();
+    for (int i = 0; i < numFiles; i++) {
+	sprintf(name, "f%d", i);
+	ASSERT(directory->Find(name) == i);
+    }
+    findTime = HostTime() - start;
+
+    start = HostTime();
+    for (int i = 0; i < numFiles; i++) {
+	sprintf(name, "f%d", i);
+	ASSERT(LinearFind(directory, name) == i);
+    }
+    scanTime = HostTime() - start;
+
+    start = HostTime();
+    for (int i = 0; i < numFiles; i++) {
+	sprintf(name, "f%d", i);
+	ASSERT(directory->Remove(name));
+    }
+    removeTime = HostTime() - start;
+    ASSERT(directory->isEmpty());
+
+    cout << "Directory " << numFiles << " files: add " << addTime 
+	 << "s, find " << findTime << "s (linear scan " << scanTime 
+	 << "s), remove " << removeTime << "s\n";
+    delete directory;
+}
+
+//----------------------------------------------------------------------
+// Kernel::Benchmark
+//      Run the micro-benchmarks, printing how fast the simulator's own
+//	data structures run on the host.
+//----------------------------------------------------------------------
+
+void
+Kernel::Benchmark() {
+    LibBenchmark();		// bitmaps
+    DirectoryBenchmark();	// directory lookups
+    for (int pages = 16; pages <= 256; pages <<= 2) {
+	AddrSpace::Benchmark(pages); // address translation
+    }
+}
+
 int 
 Kernel::getQuantum() {
   return quantum;
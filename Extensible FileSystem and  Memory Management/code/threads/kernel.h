@@ -31,8 +31,15 @@ class PostOfficeOutput;
 class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
+class SectorCache;
 
 class Locks;
+class Lock;
+class Semaphore;
+
+// Page replacement policies, chosen with -pr (or -R for random)
+
+enum PagePolicy { PageLRU, PageRandom, PageClock };
 
 class Kernel {
   public:
@@ -50,6 +57,8 @@ class Kernel {
 
     void NetworkTest();         // interactive 2-machine network test
 
+    void Benchmark();		// time the performance-critical routines
+
     int getQuantum();
     
 // These are public for notational convenience; really, 
@@ -64,6 +73,7 @@ class Kernel {
     SynchConsoleInput *synchConsoleIn;
     SynchConsoleOutput *synchConsoleOut;
     SynchDisk *synchDisk;
+    SectorCache *sectorCache;	// buffer cache in front of synchDisk
     FileSystem *fileSystem;     
     PostOfficeInput *postOfficeIn;
     PostOfficeOutput *postOfficeOut;
@@ -84,15 +94,39 @@ class Kernel {
 
     int hostName;               // machine identifier
     OpenFile *swapSpace;
-    int swapCounter;
+    Bitmap *swapMap;		// swap slots in use
+    Bitmap *swapFilled;		// slots a page has been written to;
+				// other pages come from their program
+    int *swapRefs;		// page table entries naming each slot;
+				// more than one after a fork
     Bitmap *freeMap;
     LRUCache *EntryCache;  // LRU cache
-    List<TranslationEntry * > *FIFO;
     int ThreadId;
     map<int,Thread*> *ProcessTable;
-    bool isRandom;
+    PagePolicy pagePolicy;	// how to pick a page to evict
+    CoreMapEntry *coreMap;	// who maps each physical page
+    map<pair<int, int>, int> *codePages; // (program header sector, page)
+				// -> physical page holding that code
+    int clockHand;		// next physical page CLOCK looks at
+    int faultAround;		// most pages read in along with a faulted
+				// one (-fa); each process adapts its own
+				// window up to this
+    Lock *pagingLock;		// held while a page fault, or the page
+				// daemon, moves pages in or out
+    int freeLow;		// wake the page daemon below this many
+				// free physical pages (-wm)
+    int freeHigh;		// it evicts until this many are free;
+				// 0 means no page daemon
+    Semaphore *pageDaemonWake;	// V'ed to wake the page daemon
+    bool pageDaemonAwake;	// is it already evicting?
+    bool decodeCache;		// keep decoded user instructions (-nd
+				// turns it off)
+    bool reportMips;		// print the simulated MIPS rate (-mips)
     bool useTLB;
-    LRUCache *TLBCache; // TLB cache
+    int tlbSize;		// TLB entries (-ts)
+    int tlbWays;		// TLB associativity (-ta)
+    TLBPolicy tlbPolicy;	// TLB replacement (-tr)
+    int nextAsid;		// address space ID to give out next
     char *consoleIn;            // file to read console input from 
     char *consoleOut;           // file to send console output to
 
@@ -101,6 +135,8 @@ class Kernel {
     bool debugUserProg;         // single step user program
     double reliability;         // likelihood messages are dropped
     int quantum;
+    int cacheSectors;		// # of sectors in the buffer cache
+    char *diskPolicy;		// disk scheduling policy name
 #ifndef FILESYS_STUB
     bool formatFlag;          // format the disk if this is true
 #endif
@@ -7,7 +7,7 @@
 //              -f -cp <unix file> <nachos file>
 //              -p <nachos file> -r <nachos file> -l -D
 //              -n <network reliability> -m <machine id>
-//              -z -K -C -N
+//              -z -K -C -N -B
 //
 //    -d causes certain debugging messages to be printed (see debug.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
@@ -21,6 +21,23 @@
 //    -K run a simple self test of kernel threads and synchronization
 //    -C run an interactive console test
 //    -N run a two-machine network test (see Kernel::NetworkTest)
+//    -B run the micro-benchmarks (see Kernel::Benchmark)
+//    -pr picks the page replacement policy: lru (the default), random
+//	or clock
+//    -ts, -ta set the number of TLB entries and how many there are in
+//	each set (both 4 by default); the TLB is used with -T
+//    -tr picks the TLB replacement policy: lru (the default), fifo or
+//	random
+//    -fa sets the most pages read from swap along with a faulted page
+//	(4 by default, 0 turns fault-around off, at most 1/8 of the
+//	physical pages)
+//    -wm sets the page daemon's watermarks: it is woken when fewer
+//	than the first number of physical pages are free, and evicts
+//	until the second number are (8 and 16 by default; -wm 0 0 turns
+//	the daemon off)
+//    -nd turns off the cache of decoded user instructions
+//    -mips prints how many simulated instructions ran per host second,
+//	to compare runs with and without -nd
 //
 //    Filesystem-related flags:
 //    -f forces the Nachos disk to be formatted
@@ -29,6 +46,9 @@
 //    -r removes a Nachos file from the file system
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
+//    -bc sets the number of sectors in the buffer cache
+//    -ds picks the disk scheduling policy: fifo, sstf, clook (the
+//	default) or deadline
 //
 //  Note: the file system flags are not used if the stub filesystem
 //        is being used
@@ -187,6 +207,7 @@ main(int argc, char **argv)
     bool threadTestFlag = false;
     bool consoleTestFlag = false;
     bool networkTestFlag = false;
+    bool benchmarkFlag = false;
     int quantum = 100;
     bool isRandom = false;
     bool useTLB = false;
@@ -225,6 +246,9 @@ main(int argc, char **argv)
 	else if (strcmp(argv[i], "-N") == 0) {
 	    networkTestFlag = TRUE;
 	}
+	else if (strcmp(argv[i], "-B") == 0) {
+	    benchmarkFlag = TRUE;
+	}
   else if (strcmp(argv[i], "-Q") == 0) { // parse the quantum
           quantum = atoi(argv[i + 1]);
           i++;
@@ -264,7 +288,7 @@ main(int argc, char **argv)
 	else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-z -d debugFlags]\n";
             cout << "Partial usage: nachos [-x programName]\n";
-	    cout << "Partial usage: nachos [-K] [-C] [-N]\n";
+	    cout << "Partial usage: nachos [-K] [-C] [-N] [-B]\n";
 #ifndef FILESYS_STUB
             cout << "Partial usage: nachos [-cp UnixFile NachosFile]\n";
             cout << "Partial usage: nachos [-p fileName] [-r fileName]\n";
@@ -293,6 +317,9 @@ main(int argc, char **argv)
     if (networkTestFlag) {
       kernel->NetworkTest();   // two-machine test of the network
     }
+    if (benchmarkFlag) {
+      kernel->Benchmark();     // micro-benchmarks
+    }
 
 #ifndef FILESYS_STUB
     if (removeFileName != NULL) {
@@ -19,7 +19,6 @@
 #include "main.h"
 #include "addrspace.h"
 #include "machine.h"
-#include "noff.h"
 
 //----------------------------------------------------------------------
 // SwapHeader
@@ -67,6 +66,19 @@ SwapHeader (NoffHeader *noffH)
 
 AddrSpace::AddrSpace()
 {
+  pageDirectory = NULL;
+  numPages = 0;
+  dataPages = 0;
+  stackPages = 0;
+  brk = 0;
+  faultWindow = kernel->faultAround;
+  lastFault = -1;
+  prefetched = new List<int>();
+  openFileTable = NULL;
+  executable = NULL;
+  execName = NULL;
+  execSector = -1;
+  asid = kernel->nextAsid++;
   currentDirSector = 1;
   currentDir = kernel->fileSystem->getFullName(currentDirSector);
 }
@@ -78,18 +90,25 @@ AddrSpace::AddrSpace()
 
 AddrSpace::~AddrSpace()
 {
-  for (int i = 0; i < numPages; i++) {
-    if (pageTable[i].physicalPage != -1) {
-      kernel->freeMap->Clear(pageTable[i].physicalPage); // free the memory
-      kernel->stats->memRefNum = kernel->stats->memRefNum - PageSize;
-      DEBUG(dbgSys, "Free the space. Memory Referrence Num:" << kernel->stats->memRefNum);
-      if (kernel->useTLB == TRUE) {
-        kernel->machine->DeleteTLB(&pageTable[i]);
+  FreeSwap();
+  if (pageDirectory != NULL) {
+    for (int d = 0; d < PageDirSize; d++) {
+      if (pageDirectory[d] == NULL) {
+        continue;
       }
+      for (int i = 0; i < PageLeafSize; i++) {
+        if (pageDirectory[d][i].valid) {
+          UnmapPage(d * PageLeafSize + i); // free the memory, unless a fork still shares it
+        }
+      }
+      delete [] pageDirectory[d];
     }
+    delete [] pageDirectory;
   }
-   delete pageTable;
+   delete prefetched;
    delete openFileTable;
+   delete executable;			// close file
+   delete [] execName;
 }
 
 
@@ -97,6 +116,16 @@ AddrSpace::~AddrSpace()
 // AddrSpace::Load
 // 	Load a user program into memory from a file.
 //
+//	Nothing but the header is read here: every page starts out
+//	invalid, and is brought in by PageIn the first time it is
+//	touched.  The file stays open for that until the address
+//	space goes away.
+//
+//	Code and data are mapped from page 0 up, and the stack at the
+//	very top of the virtual address space; the hole in between is
+//	left for the heap to grow into (see Sbrk), and costs no page
+//	table entries until it is used.
+//
 //	Assumes that the page table has been initialized, and that
 //	the object code file is in NOFF format.
 //
@@ -106,18 +135,20 @@ AddrSpace::~AddrSpace()
 bool 
 AddrSpace::Load(char *fileName) 
 {  
-    OpenFile *executable = kernel->fileSystem->Open(fileName);
+    executable = kernel->fileSystem->Open(fileName);
     openFileTable = new map<string, int>();
    // (*openFileTable)[string(kernel->consoleIn)] = 0; // stdin
    // (*openFileTable)[string(kernel->consoleOut)] = 1; // stdout
 
-    NoffHeader noffH;
     unsigned int size;
 
     if (executable == NULL) {
 	cerr << "Unable to open file " << fileName << "\n";
 	return FALSE;
     } 
+    execName = new char[strlen(fileName) + 1];
+    strcpy(execName, fileName);
+    execSector = executable->getHdrSector();
     
     executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
     if ((noffH.noffMagic != NOFFMAGIC) && 
@@ -126,55 +157,28 @@ AddrSpace::Load(char *fileName)
     ASSERT(noffH.noffMagic == NOFFMAGIC);
 
 #ifdef RDATA
-// how big is address space?
+// how big are code and data?
     size = noffH.code.size + noffH.readonlyData.size + noffH.initData.size +
-           noffH.uninitData.size + UserStackSize;	
-                                                // we need to increase the size
-						// to leave room for the stack
+           noffH.uninitData.size;
 #else
-// how big is address space?
-    size = noffH.code.size + noffH.initData.size + noffH.uninitData.size 
-			+ UserStackSize;	// we need to increase the size
-						// to leave room for the stack
+// how big are code and data?
+    size = noffH.code.size + noffH.initData.size + noffH.uninitData.size;
 #endif
-    numPages = divRoundUp(size, PageSize);
-    size = numPages * PageSize;
-
-    //ASSERT(numPages <= NumPhysPages);		// check we're not trying
-						// to run anything too big --
-						// at least until we have
-						// virtual memory
-
-    DEBUG(dbgAddr, "Initializing address space: " << numPages << ", " << size);
-
-// then, copy in the code and data segments into memory
+    dataPages = divRoundUp(size, PageSize);
+    stackPages = divRoundUp(UserStackSize, PageSize);
+    ASSERT(dataPages + stackPages <= NumVirtPages);
 
-    pageTable = new TranslationEntry[numPages];
-    for (int i = 0; i < numPages; i++) {
-      pageTable[i].virtualPage = kernel->swapCounter;	// virt page #  = swap_Counter
-      pageTable[i].physicalPage = -1;
-      pageTable[i].valid = FALSE;
-      pageTable[i].use = FALSE;
-      pageTable[i].dirty = FALSE;
-      pageTable[i].readOnly = FALSE;
-
-      char* buffer = new char[PageSize];
-      executable->ReadAt(buffer, PageSize, noffH.code.inFileAddr+(PageSize*i)); // read from file by page size // when write back, read header to fetch the addr again
-      kernel->swapSpace->WriteAt(buffer, PageSize, kernel->swapCounter*PageSize); // write to swapspace
-      kernel->swapCounter++;
+    if (kernel->swapMap->NumClear() < dataPages + stackPages) {
+	cerr << "Not enough swap space for " << fileName << "\n";
+	return FALSE;
     }
 
-#ifdef RDATA
-    if (noffH.readonlyData.size > 0) {
-        DEBUG(dbgAddr, "Initializing read only data segment.");
-	DEBUG(dbgAddr, noffH.readonlyData.virtualAddr << ", " << noffH.readonlyData.size);
-        executable->ReadAt(
-		&(kernel->machine->mainMemory[noffH.readonlyData.virtualAddr]),
-			noffH.readonlyData.size, noffH.readonlyData.inFileAddr);
-    }
-#endif
+    DEBUG(dbgAddr, "Initializing address space: " << dataPages << " data pages, " << stackPages << " stack pages");
+
+    MapPages(0, dataPages);
+    MapPages(NumVirtPages - stackPages, stackPages);
+    brk = dataPages * PageSize;		// the heap starts out empty
 
-    delete executable;			// close file
     return TRUE;			// success
 }
 
@@ -236,8 +240,8 @@ AddrSpace::InitRegisters()
    // Set the stack register to the end of the address space, where we
    // allocated the stack; but subtract off a bit, to make sure we don't
    // accidentally reference off the end!
-    machine->WriteRegister(StackReg, numPages * PageSize - 16);
-    DEBUG(dbgAddr, "Initializing stack pointer: " << numPages * PageSize - 16);
+    machine->WriteRegister(StackReg, NumVirtPages * PageSize - 16);
+    DEBUG(dbgAddr, "Initializing stack pointer: " << NumVirtPages * PageSize - 16);
 }
 
 //----------------------------------------------------------------------
@@ -256,13 +260,16 @@ void AddrSpace::SaveState()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table, and
+//	which address space ID to match TLB entries against.  The TLB
+//	does not need to be flushed.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
-    kernel->machine->pageTable = pageTable;
-    kernel->machine->pageTableSize = numPages;
+    kernel->machine->pageDirectory = pageDirectory;
+    kernel->machine->pageTableSize = NumVirtPages;
+    kernel->machine->currentAsid = asid;
 }
 
 
@@ -273,6 +280,10 @@ void AddrSpace::RestoreState()
 //  The flag _isReadWrite_ is false (0) for read-only access; true (1)
 //  for read-write access.
 //  Return any exceptions caused by the address translation.
+//
+//  The entry is found by indexing the page directory and then the
+//  leaf with the virtual page number; "virtualPage" holds the swap
+//  slot, not the page number, and must not be searched for.
 //----------------------------------------------------------------------
 ExceptionType
 AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite) //
@@ -282,72 +293,288 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite) /
     unsigned int      vpn    = vaddr / PageSize;
     unsigned int      offset = vaddr % PageSize;
 
-    //if(vpn >= numPages) {
-    //    return AddressErrorException;
-    //}
+    pte = getPageEntry(vpn);
+    if (pte == NULL) {
+      DEBUG(dbgAddr, "Illegal virtual page # " << vaddr);
+      return AddressErrorException;
+    }
+    if (!pte->valid) {
+      return PageFaultException;
+    }
+    if (isReadWrite && pte->readOnly) {
+      return ReadOnlyException;
+    }
+
+    // if the pageFrame is too big, there is something really wrong!
+    // An invalid translation was loaded into the page table or TLB.
+    pfn = pte->physicalPage;
+    if (pfn >= NumPhysPages) {
+      DEBUG(dbgAddr, "Illegal physical page " << pfn);
+      return BusErrorException;
+    }
 
-    // check TLB first
+    pte->use = TRUE;          // set the use, dirty bits
+    if (isReadWrite)
+      pte->dirty = TRUE;
 
-    // if not in TLB, check for all pte
+    *paddr = pfn * PageSize + offset;
+    ASSERT((*paddr < MemorySize));
+    DEBUG(dbgAddr, "PHYMEM: " << *paddr);
+
+    return NoException;
+}
+
+//----------------------------------------------------------------------
+// ScanTranslate
+// 	Translate "vaddr" the way AddrSpace::Translate used to, by
+//	scanning the whole page table for the page.  The baseline for
+//	AddrSpace::Benchmark.
+//----------------------------------------------------------------------
+
+static ExceptionType
+ScanTranslate(TranslationEntry *pageTable, unsigned int numPages,
+              unsigned int vaddr, unsigned int *paddr)
+{
+    unsigned int vpn = vaddr / PageSize;
     bool isInMem = FALSE;
 
-    for (int i = 0; i < numPages; i++) {
-      if (pageTable[i].virtualPage == vpn && pageTable[i].valid == TRUE) {
+    for (unsigned int i = 0; i < numPages; i++) {
+      if (pageTable[i].virtualPage == (int)vpn && pageTable[i].valid == TRUE) {
         isInMem = TRUE;
       }
     }
+    if (!isInMem) {
+      return PageFaultException;
+    }
+    pageTable[vpn].use = TRUE;
+    *paddr = pageTable[vpn].physicalPage * PageSize + vaddr % PageSize;
+    return NoException;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Benchmark
+// 	Time Translate on an address space of "pages" resident
+//	pages, touching every word of it in turn, against the old
+//	scan of a linear page table.  Print translations per second.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Benchmark(int pages)
+{
+    AddrSpace *space = new AddrSpace();
+    TranslationEntry *linear = new TranslationEntry[pages];
+    unsigned int size = pages * PageSize;
+    int rounds = max(1, (1 << 20) / (int)(size / 4));	// ~1M translations
+    unsigned int paddr, check = 0;
+    double start, scanTime, indexTime;
+
+    space->numPages = pages;
+    for (int i = 0; i < pages; i++) {
+      TranslationEntry *entry = space->LeafEntry(i);
+
+      linear[i].virtualPage = i;	// so the scan finds it
+      linear[i].physicalPage = i % NumPhysPages;
+      linear[i].valid = TRUE;
+      linear[i].readOnly = FALSE;
+      linear[i].use = FALSE;
+      linear[i].dirty = FALSE;
+      *entry = linear[i];
+    }
 
-    if (isInMem == TRUE) {
-      pte = &pageTable[vpn];
-      if (isReadWrite && pte->readOnly) {
-        return ReadOnlyException;
+    start = HostTime();
+    for (int r = 0; r < rounds; r++) {
+      for (unsigned int vaddr = 0; vaddr < size; vaddr += 4) {
+        ASSERT(ScanTranslate(linear, pages, vaddr, &paddr) == NoException);
+        check += paddr;
       }
+    }
+    scanTime = HostTime() - start;
 
-      pfn = pte->physicalPage;
-      pte->use = TRUE;          // set the use, dirty bits
+    start = HostTime();
+    for (int r = 0; r < rounds; r++) {
+      for (unsigned int vaddr = 0; vaddr < size; vaddr += 4) {
+        ASSERT(space->Translate(vaddr, &paddr, 0) == NoException);
+        check -= paddr;
+      }
+    }
+    indexTime = HostTime() - start;
+    ASSERT(check == 0);			// both did the same thing
 
-      if (isReadWrite)
-        pte->dirty = TRUE;
+    double translations = (double)rounds * (size / 4);
+    cout << "Translate " << pages << " pages: scan "
+         << translations / scanTime / 1e6 << " M/s, index "
+         << translations / indexTime / 1e6 << " M/s, speedup "
+         << scanTime / indexTime << "\n";
 
-      *paddr = pte->physicalPage + offset;
-      cout << "PHYMEM:" << *paddr << "\n";
-     ASSERT((*paddr >= 0) && ((*paddr) <= MemorySize));
-     DEBUG(dbgAddr, "phys addr = " << *paddr);
-      ASSERT((*paddr < MemorySize));
+    for (int i = 0; i < pages; i++) {
+      TranslationEntry *entry = space->getPageEntry(i);
 
-      //cerr << " -- AddrSpace::Translate(): vaddr: " << vaddr <<
-      //  ", paddr: " << *paddr << "\n";
+      entry->valid = FALSE;		// the frames are not really ours,
+      entry->virtualPage = -1;		// nor are the swap slots
+    }
+    space->numPages = 0;
+    delete space;
+    delete [] linear;
+}
 
-      return NoException;
+//----------------------------------------------------------------------
+// AddrSpace::getPageEntry
+// 	Return the page table entry of page "vpn", or NULL if the page
+//	is not part of the address space.
+//----------------------------------------------------------------------
+
+TranslationEntry* 
+AddrSpace::getPageEntry(int vpn) {
+  TranslationEntry *leaf;
+
+  if (pageDirectory == NULL || vpn < 0 || vpn >= NumVirtPages) {
+    return NULL;
+  }
+  leaf = pageDirectory[vpn / PageLeafSize];
+  if (leaf == NULL || leaf[vpn % PageLeafSize].virtualPage == -1) {
+    return NULL; // no swap slot, so never mapped
+  }
+  return &leaf[vpn % PageLeafSize];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::LeafEntry
+// 	Return the page table entry of page "vpn", allocating the page
+//	directory and the leaf holding the entry if they do not exist
+//	yet.  A new leaf's entries are not in the address space:
+//	"virtualPage" (the swap slot) is -1 until MapPages sets it.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+AddrSpace::LeafEntry(int vpn)
+{
+    TranslationEntry **leaf;
+
+    ASSERT(vpn >= 0 && vpn < NumVirtPages);
+    if (pageDirectory == NULL) {
+      pageDirectory = new TranslationEntry*[PageDirSize];
+      for (int i = 0; i < PageDirSize; i++) {
+        pageDirectory[i] = NULL;
+      }
     }
-    else {
-      return PageFaultException;
+    leaf = &pageDirectory[vpn / PageLeafSize];
+    if (*leaf == NULL) {
+      *leaf = new TranslationEntry[PageLeafSize];
+      for (int i = 0; i < PageLeafSize; i++) {
+        (*leaf)[i].virtualPage = -1;
+        (*leaf)[i].physicalPage = -1;
+        (*leaf)[i].valid = FALSE;
+        (*leaf)[i].readOnly = FALSE;
+        (*leaf)[i].use = FALSE;
+        (*leaf)[i].dirty = FALSE;
+      }
+      DEBUG(dbgAddr, "New page table leaf for pages " << vpn - vpn % PageLeafSize);
     }
+    return &(*leaf)[vpn % PageLeafSize];
+}
 
-    // if the pageFrame is too big, there is something really wrong!
-    // An invalid translation was loaded into the page table or TLB.
-    if (pfn >= NumPhysPages) {
-        DEBUG(dbgAddr, "Illegal physical page " << pfn);
-        return BusErrorException;
+//----------------------------------------------------------------------
+// AddrSpace::MapPages
+// 	Add the "count" pages starting at "first" to the address space.
+//	Each gets a swap slot, but no memory: it is read in, or zeroed,
+//	the first time it is touched.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::MapPages(int first, int count)
+{
+    for (int vpn = first; vpn < first + count; vpn++) {
+      LeafEntry(vpn)->readOnly = IsCodePage(vpn); // may be shared by other runs
     }
+    AllocateSwap(first, count);		// virt page # = swap slot
+    numPages += count;
 }
 
-TranslationEntry* 
-AddrSpace::getPageEntry(int pageFaultPhysicalNum) {
-  return &pageTable[pageFaultPhysicalNum]; // return pointer of the required entry.
+//----------------------------------------------------------------------
+// AddrSpace::Sbrk
+// 	Move the end of the heap up by "increment" bytes, and return
+//	where it used to be.  The new pages are mapped but not touched,
+//	so they cost nothing but a swap slot (and maybe a page table
+//	leaf) until they are used, and come in zero-filled.
+//
+//	Return -1, and leave the heap alone, if the heap would run
+//	into the stack or there is not enough swap space.  The heap
+//	cannot shrink.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::Sbrk(int increment)
+{
+    int oldBrk = brk;
+    int first, last;
+
+    if (increment < 0 || increment > (NumVirtPages - stackPages) * PageSize - brk) {
+      return -1;
+    }
+    first = divRoundUp(brk, PageSize);	// first page not yet mapped
+    last = divRoundUp(brk + increment, PageSize);
+    if (last - first > kernel->swapMap->NumClear()) {
+      return -1;
+    }
+    if (last > first) {
+      MapPages(first, last - first);
+    }
+    brk += increment;
+    DEBUG(dbgAddr, "Heap grown by " << increment << " to " << brk);
+    return oldBrk;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::AddrSpace(const AddrSpace&)
+// 	Fork an address space, copy-on-write.
+//
+//	Nothing is copied: every page of the child names the same
+//	physical page and swap slot as the parent's, and both sides
+//	are made read-only.  The first write to such a page traps,
+//	and the exception handler gives the writer a private copy.
+//----------------------------------------------------------------------
+
 AddrSpace::AddrSpace(const AddrSpace& copiedItem) { // copy constructor
+  pageDirectory = NULL;
   numPages = copiedItem.numPages;
-  pageTable = new TranslationEntry[numPages];
-  for (int i = 0; i < numPages; i++) {
-      pageTable[i].virtualPage = copiedItem.pageTable[i].virtualPage;
-      pageTable[i].physicalPage = copiedItem.pageTable[i].physicalPage;
-      pageTable[i].valid = copiedItem.pageTable[i].valid;
-      pageTable[i].use = copiedItem.pageTable[i].use;
-      pageTable[i].dirty = copiedItem.pageTable[i].dirty;
-      pageTable[i].readOnly = copiedItem.pageTable[i].readOnly;
+  dataPages = copiedItem.dataPages;
+  stackPages = copiedItem.stackPages;
+  brk = copiedItem.brk;
+  faultWindow = copiedItem.faultWindow; // the child runs the same code
+  lastFault = -1;
+  prefetched = new List<int>();
+  asid = kernel->nextAsid++; // a different page table, so a new ID
+  noffH = copiedItem.noffH;
+  execSector = copiedItem.execSector;
+  execName = NULL;
+  executable = NULL;
+  if (copiedItem.execName != NULL) { // for pages still only in the program
+    execName = new char[strlen(copiedItem.execName) + 1];
+    strcpy(execName, copiedItem.execName);
+    executable = kernel->fileSystem->Open(execName);
+  }
+  for (int d = 0; d < PageDirSize; d++) {
+    if (copiedItem.pageDirectory == NULL || copiedItem.pageDirectory[d] == NULL) {
+      continue;
+    }
+    for (int i = 0; i < PageLeafSize; i++) {
+      TranslationEntry *from = &copiedItem.pageDirectory[d][i];
+      TranslationEntry *to;
+
+      if (from->virtualPage == -1) { // not in the address space
+        continue;
+      }
+      to = LeafEntry(d * PageLeafSize + i);
+      *to = *from; // same physical page, same swap slot
+      kernel->swapRefs[from->virtualPage]++;
+      if (from->valid) {
+        kernel->coreMap[from->physicalPage].owners->Append(this);
+      }
+      from->readOnly = TRUE; // copied on the first write
+      to->readOnly = TRUE;
+    }
   }
+  kernel->stats->numForkedPages += numPages;
   currentDirSector = copiedItem.currentDirSector;
   currentDir = copiedItem.currentDir;
 
@@ -361,17 +588,396 @@ AddrSpace::AddrSpace(const AddrSpace& copiedItem) { // copy constructor
   }
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::AllocateSwap
+// 	Give each of the "count" pages starting at "first" a slot in the
+//	swap file, and record it in the page's "virtualPage" field.  We
+//	try to get one contiguous run of slots, so the pages sit next
+//	to each other on disk; if swap is too fragmented for that, the
+//	pages are given whatever slots are free.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::AllocateSwap(int first, int count)
+{
+    int run = kernel->swapMap->FindContiguousRange(count);
+
+    for (int i = 0; i < count; i++) {
+      TranslationEntry *entry = LeafEntry(first + i);
+
+      if (run != -1) {
+        entry->virtualPage = run + i;
+        kernel->swapMap->Mark(run + i);
+      }
+      else {
+        entry->virtualPage = kernel->swapMap->FindAndSet();
+        ASSERT(entry->virtualPage != -1);	// Load and Sbrk checked for room
+      }
+      kernel->swapRefs[entry->virtualPage] = 1;
+    }
+    DEBUG(dbgAddr, "Swap slots for " << count << " pages, " << (run != -1 ? "contiguous at " : "scattered") << run);
+
+    kernel->stats->numSwapSlotsInUse += count;
+    if (kernel->stats->numSwapSlotsInUse > kernel->stats->maxSwapSlotsInUse) {
+      kernel->stats->maxSwapSlotsInUse = kernel->stats->numSwapSlotsInUse;
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FreeSwap
+// 	Give back the swap slots of every page of the address space.
+//	A slot still shared with a forked address space is kept until
+//	the last one lets go of it.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::FreeSwap()
+{
+    if (pageDirectory == NULL) {
+      return;
+    }
+    for (int d = 0; d < PageDirSize; d++) {
+      if (pageDirectory[d] == NULL) {
+        continue;
+      }
+      for (int i = 0; i < PageLeafSize; i++) {
+        int slot = pageDirectory[d][i].virtualPage;
+
+        if (slot == -1 || --kernel->swapRefs[slot] > 0) {
+          continue;
+        }
+        kernel->swapMap->Clear(slot);
+        if (kernel->swapFilled->Test(slot)) {
+          kernel->swapFilled->Clear(slot);
+        }
+        kernel->stats->numSwapSlotsInUse--;
+      }
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PrivateSwapSlot
+// 	Make sure page "vpn" is the only one using its swap slot, so
+//	that writing it back cannot change another address space's
+//	page.  A new slot starts out empty; the caller must mark the
+//	page dirty, so it is written there before it is dropped.
+//
+//	Return FALSE, changing nothing, if swap is full.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::PrivateSwapSlot(int vpn)
+{
+    TranslationEntry *entry = getPageEntry(vpn);
+    int slot = entry->virtualPage;
+
+    if (kernel->swapRefs[slot] == 1) {
+      return TRUE;
+    }
+    slot = kernel->swapMap->FindAndSet();
+    if (slot == -1) {			// out of swap space
+      return FALSE;
+    }
+    kernel->swapRefs[entry->virtualPage]--;
+    kernel->swapRefs[slot] = 1;
+    entry->virtualPage = slot;
+
+    kernel->stats->numSwapSlotsInUse++;
+    if (kernel->stats->numSwapSlotsInUse > kernel->stats->maxSwapSlotsInUse) {
+      kernel->stats->maxSwapSlotsInUse = kernel->stats->numSwapSlotsInUse;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::UnmapPage
+// 	Drop page "vpn"'s hold on its physical page.  The physical page
+//	is freed if nothing else maps it; otherwise it stays with the
+//	address spaces that share it through a fork.  The core map says
+//	which it is, so this takes no search of other page tables.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::UnmapPage(int vpn)
+{
+    TranslationEntry *entry = getPageEntry(vpn);
+    int frame = entry->physicalPage;
+    CoreMapEntry *core = &kernel->coreMap[frame];
+
+    ASSERT(core->vpn == vpn && core->pinCount == 0);
+    core->owners->Remove(this);
+    if (core->owners->IsEmpty()) {
+      kernel->freeMap->Clear(frame);
+      if (kernel->pagePolicy == PageLRU) {
+        kernel->EntryCache->remove(frame);
+      }
+      UncacheFrame(frame);
+      core->vpn = -1;
+      core->dirty = FALSE;
+      kernel->stats->memRefNum = kernel->stats->memRefNum - PageSize;
+      DEBUG(dbgSys, "Free the space. Memory Referrence Num:" << kernel->stats->memRefNum);
+    }
+    entry->physicalPage = -1;
+    entry->valid = FALSE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageIn
+// 	Fill the physical frame that was just given to page "vpn".
+//
+//	Once a page has been written to swap, the swap copy is the
+//	real one.  Until then the page is still what the program file
+//	says: code and data are read from the executable, and the
+//	rest (uninitialized data, stack) is zero.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::PageIn(int vpn)
+{
+    TranslationEntry *entry = getPageEntry(vpn);
+    char *frame = &(kernel->machine->mainMemory[entry->physicalPage * PageSize]);
+    bool fromFile;
+
+    if (kernel->swapFilled->Test(entry->virtualPage)) {
+      kernel->swapSpace->ReadAt(frame, PageSize, entry->virtualPage * PageSize);
+      kernel->stats->numSwapReads++;
+      return;
+    }
+
+    bzero(frame, PageSize);
+    fromFile = LoadSegment(&noffH.code, vpn, frame);
+#ifdef RDATA
+    fromFile = LoadSegment(&noffH.readonlyData, vpn, frame) || fromFile;
+#endif
+    fromFile = LoadSegment(&noffH.initData, vpn, frame) || fromFile;
+    if (fromFile) {
+      kernel->stats->numFilePageIns++;
+    }
+    else {
+      kernel->stats->numZeroFills++;
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FaultAround
+// 	Page "vpn" has faulted; return how many of the pages right after
+//	it should be read in with it.  These are the pages that are not
+//	in memory, whose contents are in swap, and whose swap slots
+//	follow the faulted page's, so that the whole run is a single
+//	disk transfer.  Pages that come from the program file, or are
+//	zero, are left to fault in on their own.
+//
+//	The window is adapted too.  Every page read ahead earlier that
+//	has since been used widens the window by one, up to -fa; every
+//	one that was evicted without being used halves it (see Evicted,
+//	which judges pages before their "use" bit is lost).  Once the
+//	window is down to zero, a fault on the page after the last one
+//	(the program is walking through memory again) reopens it.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::FaultAround(int vpn)
+{
+    TranslationEntry *entry = getPageEntry(vpn);
+    int pending = prefetched->NumInList();
+    int count = 0;
+
+    for (int i = 0; i < pending; i++) { // judge what was read ahead
+      int page = prefetched->RemoveFront();
+      TranslationEntry *ahead = getPageEntry(page);
+
+      if (!ahead->valid) {		// unmapped, without being evicted
+        continue;
+      }
+      if (ahead->use) {
+        JudgePrefetch(TRUE);
+      }
+      else {
+        prefetched->Append(page);	// no verdict yet
+      }
+    }
+    if (faultWindow == 0 && vpn == lastFault + 1) {
+      faultWindow = min(1, kernel->faultAround);
+    }
+    lastFault = vpn;
+
+    if (!kernel->swapFilled->Test(entry->virtualPage)) {
+      return 0;
+    }
+    while (count < faultWindow) {
+      TranslationEntry *next = getPageEntry(vpn + count + 1);
+
+      if (next == NULL || next->valid
+          || next->virtualPage != entry->virtualPage + count + 1
+          || !kernel->swapFilled->Test(next->virtualPage)) {
+        break;
+      }
+      count++;
+    }
+    DEBUG(dbgAddr, "Fault on page " << vpn << ", window " << faultWindow << ", reading " << count << " more");
+    return count;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Prefetched
+// 	Page "vpn" has just been read in by fault-around.  Its "use" bit
+//	is clear; FaultAround, or Evicted if the page goes first, checks
+//	later whether the program set it.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Prefetched(int vpn)
+{
+    TranslationEntry *entry = getPageEntry(vpn);
+
+    entry->use = FALSE;
+    kernel->coreMap[entry->physicalPage].referenced = FALSE; // first to go
+    prefetched->Append(vpn);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Evicted
+// 	Page "vpn" is about to be evicted.  If it was read ahead and has
+//	not been judged yet, judge it now, while its "use" bit still says
+//	whether the program touched it; once it is faulted back in, the
+//	bit is set whether or not the prefetch was any good.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Evicted(int vpn)
+{
+    if (!prefetched->IsInList(vpn)) {
+      return;
+    }
+    prefetched->Remove(vpn);
+    JudgePrefetch(getPageEntry(vpn)->use);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::JudgePrefetch
+// 	A page read ahead by fault-around was "used" before it was
+//	evicted, or not.  Widen the window by one page for a hit, up to
+//	-fa, and halve it for a miss.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::JudgePrefetch(bool used)
+{
+    if (used) {
+      faultWindow = min(faultWindow + 1, kernel->faultAround);
+      kernel->stats->numPrefetchHits++;
+    }
+    else {
+      faultWindow = faultWindow / 2;
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::LoadSegment
+// 	Read the part of segment "seg" that lies in page "vpn" from
+//	the executable into "frame", which starts out zero.  Segments
+//	need not start or end on a page boundary.
+//
+//	Returns FALSE if none of the segment is in the page.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::LoadSegment(Segment *seg, int vpn, char *frame)
+{
+    int pageStart = vpn * PageSize;
+    int start = max(pageStart, seg->virtualAddr);
+    int end = min(pageStart + PageSize, seg->virtualAddr + seg->size);
+
+    if (executable == NULL || seg->size <= 0 || start >= end) {
+      return FALSE;
+    }
+    DEBUG(dbgAddr, "Page " << vpn << " from file offset " << seg->inFileAddr + (start - seg->virtualAddr));
+    executable->ReadAt(&frame[start - pageStart], end - start,
+                       seg->inFileAddr + (start - seg->virtualAddr));
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::IsCodePage
+// 	Return TRUE if page "vpn" lies entirely in the code segment.
+//	Such a page is never written, so every address space running
+//	the same program can map the same physical copy of it.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::IsCodePage(int vpn)
+{
+    int pageStart = vpn * PageSize;
+
+    return execSector != -1 && noffH.code.size > 0
+        && pageStart >= noffH.code.virtualAddr
+        && pageStart + PageSize <= noffH.code.virtualAddr + noffH.code.size;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CachedCodePage
+// 	Look up code page "vpn" of our program in the kernel's code
+//	page cache, keyed by (header sector of the program, page).
+//	Return the physical page holding it, or -1.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::CachedCodePage(int vpn)
+{
+    map<pair<int, int>, int>::iterator iter;
+
+    if (!IsCodePage(vpn)) {
+      return -1;
+    }
+    iter = kernel->codePages->find(make_pair(execSector, vpn));
+    if (iter == kernel->codePages->end()) {
+      return -1;
+    }
+    return iter->second;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CacheCodePage
+// 	Enter page "vpn", just read into memory, in the code page
+//	cache, if it is a code page.  It stays there until the physical
+//	page is evicted or its last user goes away.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::CacheCodePage(int vpn)
+{
+    int frame = getPageEntry(vpn)->physicalPage;
+    pair<int, int> key = make_pair(execSector, vpn);
+
+    if (!IsCodePage(vpn)) {
+      return;
+    }
+    (*kernel->codePages)[key] = frame;
+    kernel->coreMap[frame].codePage = key;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::UncacheFrame
+// 	Physical page "frame" no longer holds what it did; drop it from
+//	the code page cache if it was there.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::UncacheFrame(int frame)
+{
+    if (kernel->coreMap[frame].codePage.first == -1) {
+      return;
+    }
+    kernel->codePages->erase(kernel->coreMap[frame].codePage);
+    kernel->coreMap[frame].codePage = make_pair(-1, -1);
+}
+
 int 
 AddrSpace::getNumPage() {
   return numPages;
 }
 
 
-TranslationEntry* 
-AddrSpace::getPageTable() {
-  return pageTable;
-}
-
 bool 
 AddrSpace::isExisted(int id) {
   map<string, int>::iterator iter;
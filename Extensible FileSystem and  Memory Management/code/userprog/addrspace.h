@@ -15,10 +15,43 @@
 
 #include "copyright.h"
 #include "filesys.h"
+#include "noff.h"
 
 #include <map>
 
 #define UserStackSize		1024 	// increase this as necessary!
+#define NumSwapSlots		512	// pages the swap file can hold
+#define DefaultFaultAround	4	// fault-around window if -fa is
+					// not given
+#define MaxFaultAround		(NumPhysPages / 8)
+					// largest -fa; a clustered read pins
+					// that many frames plus one, and the
+					// rest must be left to evict
+#define DefaultFreeLow		8	// page daemon watermarks, in free
+#define DefaultFreeHigh		16	// physical pages, if -wm is not given
+
+class AddrSpace;
+
+// The following class defines the core map entry of one physical page:
+// who maps it and what state it is in.  Every mapping of a physical
+// page is at the same virtual page number, since they all come from a
+// fork or from the code page cache, so "vpn" and the list of address
+// spaces are enough to find every page table entry that points here.
+//
+// The core map is protected by kernel->pagingLock; "pinCount" keeps a
+// page in memory across the points where its holder may block.
+
+class CoreMapEntry {
+  public:
+    List<AddrSpace *> *owners;		// address spaces mapping the page;
+					// empty if it is free
+    int vpn;				// virtual page they map it at, or -1
+    int pinCount;			// > 0 if it must not be evicted
+    bool dirty;				// changed since it was read in?
+    bool referenced;			// used since the clock hand passed?
+    pair<int, int> codePage;		// (program header sector, page) if
+					// in kernel->codePages, else (-1, -1)
+};
 
 class AddrSpace {
   public:
@@ -41,10 +74,35 @@ class AddrSpace {
     // to physical address _paddr_. _mode_
     // is 0 for Read, 1 for Write.
     ExceptionType Translate(unsigned int vaddr, unsigned int *paddr, int mode);
-    TranslationEntry* getPageEntry(int pageFaultPhysicalNum);
+    static void Benchmark(int pages);	// Time Translate on "pages" pages
+    TranslationEntry* getPageEntry(int vpn); // NULL if "vpn" is not in
+					// the address space
     int getNumPage();
-    TranslationEntry* getPageTable();
+    int Sbrk(int increment);		// Grow the heap by "increment" bytes;
+					// return the old break, or -1
+    void PageIn(int vpn);		// Fill the frame just given to page
+					// "vpn", from swap or the executable
+    int FaultAround(int vpn);		// Pages after "vpn" to read from
+					// swap with it, in one transfer
+    void Prefetched(int vpn);		// Page "vpn" was read in by
+					// fault-around, and not yet used
+    void Evicted(int vpn);		// Page "vpn" is about to lose its
+					// frame; judge it if it was read ahead
+    void UnmapPage(int vpn);		// Stop using the frame of page "vpn";
+					// it is freed with its last user
+    bool PrivateSwapSlot(int vpn);	// Give page "vpn" a swap slot no
+					// other address space shares;
+					// FALSE if swap is full
 
+    bool IsCodePage(int vpn);		// Is page "vpn" nothing but code?
+    int CachedCodePage(int vpn);	// Physical page already holding code
+					// page "vpn" of this program, or -1
+    void CacheCodePage(int vpn);	// Let other runs of the program map
+					// code page "vpn", just read in
+    static void UncacheFrame(int frame); // Physical page "frame" is being
+					// freed or given to another page
+
+    int asid;				// Address space ID, tags TLB entries
     int currentDirSector;
     char* currentDir;
     map<string, int> *openFileTable;// per-process openfile table
@@ -53,14 +111,45 @@ class AddrSpace {
     //bool isExisted(char* name);
 
   private:
-    TranslationEntry *pageTable;	// Assume linear page table translation
-					// for now!
+    TranslationEntry **pageDirectory;	// Two-level page table; a leaf is
+					// only allocated once one of its
+					// pages is in the address space
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    int dataPages;			// Code and data, from page 0 up
+    int stackPages;			// Stack, at the top of the space
+    int brk;				// End of the heap, which grows up
+					// from the data
+
+    int faultWindow;			// Most pages FaultAround reads ahead;
+					// grows while they get used, and
+					// shrinks when they do not
+    int lastFault;			// Page of the last fault, or -1
+    List<int> *prefetched;		// Pages read ahead, not yet judged
+    void JudgePrefetch(bool used);	// Adapt faultWindow to whether a
+					// page read ahead was used
+
+    TranslationEntry *LeafEntry(int vpn); // Entry for "vpn", allocating
+					// its leaf if need be
+    void MapPages(int first, int count); // Add pages to the address space
 
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
 
+    void AllocateSwap(int first, int count);
+					// Give each new page a swap slot
+    void FreeSwap();			// Give the swap slots back
+
+    OpenFile *executable;		// Program file; pages that were never
+					// written to swap are read from here
+    char *execName;			// Its name, so a fork can reopen it
+    int execSector;			// Its header sector, -1 if none; the
+					// key to shared code pages
+    NoffHeader noffH;			// Where the segments are in the file
+    bool LoadSegment(Segment *seg, int vpn, char *frame);
+					// Copy the part of "seg" that falls
+					// in page "vpn" into "frame"
+
 
 };
 
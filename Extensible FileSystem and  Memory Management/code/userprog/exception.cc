@@ -26,6 +26,267 @@
 #include "syscall.h"
 #include "ksyscall.h"
 
+//----------------------------------------------------------------------
+// PickVictim
+// 	Choose the resident page to evict when there is no free physical
+//	page, according to kernel->pagePolicy:
+//
+//	PageLRU -- the least recently used page, from kernel->EntryCache,
+//		brought up to date with the references since the last
+//		timer interrupt
+//	PageRandom -- any resident page
+//	PageClock -- second chance: sweep the physical pages from the
+//		clock hand, clearing the "referenced" bit Machine::Translate
+//		sets in the core map on every reference; the first page
+//		found with it clear has not been used for a whole sweep,
+//		and is the victim
+//
+//	Pinned pages are passed over.  Return the physical page number.
+//----------------------------------------------------------------------
+
+static bool
+Evictable(int frame)
+{
+    return !kernel->coreMap[frame].owners->IsEmpty() && kernel->coreMap[frame].pinCount == 0;
+}
+
+static int
+PickVictim()
+{
+    int victim;
+
+    switch (kernel->pagePolicy) {
+      case PageRandom:
+	do {
+	    victim = RandomNumber() % NumPhysPages;
+	} while (!Evictable(victim));
+	return victim;
+
+      case PageClock:
+	for (;;) {
+	    victim = kernel->clockHand;
+	    kernel->clockHand = (kernel->clockHand + 1) % NumPhysPages;
+	    if (!Evictable(victim)) {	// free, or pinned
+		continue;
+	    }
+	    if (!kernel->coreMap[victim].referenced) {
+		return victim;
+	    }
+	    kernel->coreMap[victim].referenced = FALSE; // give it a second chance
+	}
+
+      case PageLRU:
+      default:
+	kernel->EntryCache->sweep(kernel->stats->totalTicks);
+	victim = kernel->EntryCache->oldest();
+	while (victim != -1 && !Evictable(victim)) {
+	    victim = kernel->EntryCache->newer(victim);
+	}
+	ASSERT(victim != -1);		// everything is pinned
+	return victim;
+    }
+}
+
+//----------------------------------------------------------------------
+// EvictFrame
+// 	Take a physical page away from the page picked by PickVictim,
+//	and return it.  Every page table entry mapping it (more than
+//	one, if it is shared since a fork), found through the core map,
+//	is invalidated, and its contents are written to swap if they
+//	were modified.
+//
+//	The caller holds kernel->pagingLock, so nobody can fault the
+//	page back in from swap while it is still being written there.
+//----------------------------------------------------------------------
+
+static int
+EvictFrame()
+{
+    int physicalPageNum = PickVictim();
+    CoreMapEntry *frame = &kernel->coreMap[physicalPageNum];
+    int vpn = frame->vpn;
+    int slot = frame->owners->Front()->getPageEntry(vpn)->virtualPage;
+    bool dirty = frame->dirty;
+
+    kernel->stats->numPageEvictions++;
+    if (kernel->pagePolicy == PageLRU) {
+      DEBUG(dbgSys, "Swapping out from " << slot << "(last used time: " << kernel->EntryCache->lastUsed(physicalPageNum) << ") at phy #" << physicalPageNum);
+      kernel->EntryCache->remove(physicalPageNum);
+    }
+
+    // swap out; everyone mapping the page shares its swap slot,
+    // unless it is program code, which is never written back
+    AddrSpace::UncacheFrame(physicalPageNum);
+    while (!frame->owners->IsEmpty()) {
+      AddrSpace *owner = frame->owners->RemoveFront();
+      TranslationEntry *entry = owner->getPageEntry(vpn);
+
+      owner->Evicted(vpn);		// fault-around judges its guesses
+      entry->physicalPage = -1;
+      entry->valid = FALSE;
+      entry->dirty = FALSE;
+    }
+    frame->vpn = -1;
+    frame->dirty = FALSE;
+    kernel->machine->InvalidateDecoded(physicalPageNum);
+    if (dirty) { // if the page is modified.
+      // copy evicted from memory to disk; mark the slot first, so an
+      // exit freeing it while we wait also unmarks it
+      kernel->swapFilled->Mark(slot); // swap copy is now the real one
+      int written = kernel->swapSpace->WriteAt(&(kernel->machine->mainMemory[physicalPageNum*PageSize]), PageSize, slot*PageSize); // write back
+      ASSERT(written == PageSize);	// swap is allocated at boot
+      kernel->stats->numSwapWrites++;
+    }
+    else { // the swap (or program file) copy is still good
+      kernel->stats->numSwapWritesSaved++;
+    }
+    return physicalPageNum;
+}
+
+//----------------------------------------------------------------------
+// GetFrame
+// 	Find a physical page for "pageEntry", which is about to be
+//	faulted in.  Normally the page daemon keeps some free; if it has
+//	fallen behind, evict one here.  Wake the daemon when the free
+//	pages run low.
+//----------------------------------------------------------------------
+
+static int
+GetFrame(TranslationEntry *pageEntry)
+{
+    int physicalPageNum = kernel->freeMap->FindAndSet();
+
+    if (kernel->freeHigh > 0 && !kernel->pageDaemonAwake
+        && kernel->freeMap->NumClear() < kernel->freeLow) {
+      kernel->pageDaemonAwake = TRUE;
+      kernel->pageDaemonWake->V();
+    }
+    if (physicalPageNum != -1) { // a free physical page
+      kernel->stats->memRefNum = kernel->stats->memRefNum + PageSize;
+      kernel->machine->InvalidateDecoded(physicalPageNum);
+      return physicalPageNum;
+    }
+    DEBUG(dbgSys, "No free page for swap slot " << pageEntry->virtualPage << ", evicting");
+    return EvictFrame();
+}
+
+//----------------------------------------------------------------------
+// PageDaemon
+// 	Body of the page daemon thread.  Once woken by GetFrame, evict
+//	pages, writing back the dirty ones, until at least kernel->freeHigh
+//	physical pages are free; then sleep again.  Page faults then
+//	usually find a free page, and only wait for their own page-in.
+//
+//	The paging lock is given up, and the CPU yielded, after each
+//	page, so a page fault never waits behind more than one write.
+//----------------------------------------------------------------------
+
+void
+PageDaemon()
+{
+    for (;;) {
+      kernel->pageDaemonWake->P();
+      kernel->pagingLock->Acquire();
+      while (kernel->freeMap->NumClear() < kernel->freeHigh) {
+        int physicalPageNum = EvictFrame();
+
+        kernel->freeMap->Clear(physicalPageNum);
+        kernel->stats->memRefNum = kernel->stats->memRefNum - PageSize;
+        kernel->stats->numDaemonEvictions++;
+        kernel->pagingLock->Release();
+        kernel->currentThread->Yield();
+        kernel->pagingLock->Acquire();
+      }
+      kernel->pageDaemonAwake = FALSE;
+      kernel->pagingLock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// MapFrame
+// 	Make "pageEntry", the entry of page "vpn" of the running address
+//	space, map physical page "physicalPageNum", and tell
+//	the TLB about it.  If nothing mapped the physical page before,
+//	it is recorded in the core map as just read in, and the LRU
+//	policy starts tracking it; otherwise it is shared, at the same
+//	virtual page.
+//----------------------------------------------------------------------
+
+static void
+MapFrame(TranslationEntry *pageEntry, int vpn, int physicalPageNum)
+{
+    CoreMapEntry *frame = &kernel->coreMap[physicalPageNum];
+    bool first = frame->owners->IsEmpty();
+
+    pageEntry->physicalPage = physicalPageNum;
+    pageEntry->valid = TRUE;
+    pageEntry->use = TRUE;		// it is about to be referenced
+    frame->owners->Append(kernel->currentThread->space);
+
+    if (first) {
+      frame->vpn = vpn;
+      frame->dirty = FALSE;		// the caller says otherwise
+      frame->referenced = TRUE;
+      if (kernel->pagePolicy == PageLRU) {
+        kernel->EntryCache->set(kernel->stats->totalTicks, physicalPageNum); // LRU
+      }
+    }
+    ASSERT(frame->vpn == vpn);
+
+    if (kernel->useTLB == TRUE) { // use TLB
+      kernel->machine->UpdateTLB(vpn, pageEntry);
+    }
+}
+
+//----------------------------------------------------------------------
+// ClusterPageIn
+// 	Bring page "vpn" of "space", and the "count" pages after it, in
+//	from swap with a single read; their swap slots are consecutive
+//	(see AddrSpace::FaultAround).
+//
+//	The read is done before any physical page is taken, and each
+//	page is filled as soon as it is mapped.  The pages are pinned
+//	until all of them are in, so making room for one cannot evict
+//	another.
+//----------------------------------------------------------------------
+
+static void
+ClusterPageIn(AddrSpace *space, int vpn, int count)
+{
+    TranslationEntry *pageEntry = space->getPageEntry(vpn);
+    char *buffer = new char[(count + 1) * PageSize];
+    int *pinned = new int[count + 1];
+    int numPinned = 0;
+
+    kernel->swapSpace->ReadAt(buffer, (count + 1) * PageSize, pageEntry->virtualPage * PageSize);
+    kernel->stats->numSwapReads++;
+    kernel->stats->numClusterReads++;
+
+    for (int i = count; i >= 0; i--) {
+      TranslationEntry *entry = space->getPageEntry(vpn + i);
+      int physicalPageNum;
+
+      if (entry->valid) {		// read in while we waited
+        continue;
+      }
+      physicalPageNum = GetFrame(entry);
+      entry->dirty = FALSE;		// same as its swap copy
+      MapFrame(entry, vpn + i, physicalPageNum);
+      kernel->coreMap[physicalPageNum].pinCount++;
+      pinned[numPinned++] = physicalPageNum;
+      bcopy(&buffer[i * PageSize], &(kernel->machine->mainMemory[physicalPageNum*PageSize]), PageSize);
+      if (i > 0) {
+        space->Prefetched(vpn + i);
+        kernel->stats->numPrefetchedPages++;
+      }
+    }
+    for (int i = 0; i < numPinned; i++) {
+      kernel->coreMap[pinned[i]].pinCount--;
+    }
+    delete [] pinned;
+    delete [] buffer;
+}
+
 //----------------------------------------------------------------------
 // ExceptionHandler
 // 	Entry point into the Nachos kernel.  Called when a user program
@@ -412,6 +673,29 @@ ExceptionHandler(ExceptionType which)
       }
         break;
 
+      case SC_Sbrk: {
+        DEBUG(dbgSys, "Sbrk.\n");
+        // int Sbrk(int increment);
+        int increment = (int)kernel->machine->ReadRegister(4);
+
+        result = SysSbrk(increment);
+        kernel->machine->WriteRegister(2, result);// set return value 
+        /* Modify return point */
+        {
+          /* set previous programm counter (debugging only)*/
+          kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+
+          /* set programm counter to next instruction (all Instructions are 4 byte wide)*/
+          kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+
+          /* set next programm counter for brach execution */
+          kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+        }
+        return;
+        ASSERTNOTREACHED();
+      }
+        break;
+
       case SC_Seek: {
         DEBUG(dbgSys, "Seek.\n");
         // int Seek(int position, OpenFileId id);
@@ -467,6 +751,8 @@ ExceptionHandler(ExceptionType which)
       break;
 
     case PageFaultException: {
+      int faultStart = kernel->stats->totalTicks;
+
       kernel->stats->numPageFaults++;
 
       // fetch virtual page that raises the exception
@@ -475,70 +761,36 @@ ExceptionHandler(ExceptionType which)
       // calculate virtual page number
       int pageFaultPageNum = pageFaultId / PageSize;
 
-      // check the free physical number
-      int physicalPageNum = kernel->freeMap->FindAndSet();
       // fetch pagefault entry of the current thread
-      TranslationEntry *pageEntry = kernel->currentThread->space->getPageEntry(pageFaultPageNum);
-
-      if (physicalPageNum != -1) { // in physical memory
-        pageEntry->physicalPage = physicalPageNum;
-        pageEntry->valid = TRUE;
-        kernel->swapSpace->ReadAt(&(kernel->machine->mainMemory[physicalPageNum*PageSize]), PageSize, pageEntry->virtualPage*PageSize);
-        kernel->stats->memRefNum = kernel->stats->memRefNum + PageSize;
-        if (kernel->isRandom == TRUE) {
-          kernel->FIFO->Append(pageEntry);
-        }
-        else
-        {
-          kernel->EntryCache->set(kernel->stats->totalTicks, pageEntry); // LRU
-        }
+      AddrSpace *space = kernel->currentThread->space;
+      TranslationEntry *pageEntry = space->getPageEntry(pageFaultPageNum);
+      int physicalPageNum, cluster;
 
+      if (pageEntry == NULL) { // in a leaf, but not in the address space
+        cerr << "Bad address " << pageFaultId << ", process killed\n";
+        SysExit();
+        return;
+        ASSERTNOTREACHED();
+      }
+      kernel->pagingLock->Acquire();
+      physicalPageNum = space->CachedCodePage(pageFaultPageNum);
+      pageEntry->dirty = FALSE; // same as its backing copy
+      if (physicalPageNum != -1) { // another run of the program has it
+        MapFrame(pageEntry, pageFaultPageNum, physicalPageNum);
+        kernel->stats->numSharedCodeHits++;
+      }
+      else if ((cluster = space->FaultAround(pageFaultPageNum)) > 0) {
+        ClusterPageIn(space, pageFaultPageNum, cluster);
       }
       else {
-        TranslationEntry *LRUEntry;
-        if (kernel->isRandom == TRUE) { // randomly pick
-          srand((unsigned int)time(0));
-          int random = rand() % 128;
-          TranslationEntry *randomEntry = kernel->FIFO->getItem(random);
-          LRUEntry = randomEntry;
-          kernel->FIFO->Remove(randomEntry);
-        }
-        else
-        {
-          LRUEntry = kernel->EntryCache->oldestNode()->entry; // LRU
-        }
-        // swap out
-        
-        // fetch the physical page number of the evicted page
-        int physicalPageNum = LRUEntry->physicalPage;
-        //if (LRUEntry->dirty == TRUE) { // if the file is modifed.
-          // copy evicted from memory to disk
-        kernel->swapSpace->WriteAt(&(kernel->machine->mainMemory[physicalPageNum*PageSize]), PageSize, LRUEntry->virtualPage*PageSize); // write back
-        LRUEntry->physicalPage = -1;
-        LRUEntry->valid = FALSE;
-        //}
-
-        if (kernel->isRandom == FALSE) {
-          cout << "Swapping out from " << LRUEntry->virtualPage << "(last used time: " << kernel->EntryCache->oldestNode()->LRUTime << " to " << pageEntry->virtualPage << " at phy #" << physicalPageNum << "\n";
-        }
-
-        // swap in
-        pageEntry->physicalPage = physicalPageNum;
-        pageEntry->valid = TRUE;
-        kernel->swapSpace->ReadAt(&(kernel->machine->mainMemory[physicalPageNum*PageSize]), PageSize, pageEntry->virtualPage*PageSize);
-        if (kernel->isRandom == TRUE) { // randomly pick
-          kernel->FIFO->Append(pageEntry);
-        }
-        else // LRU
-        {
-          TranslationEntry * removedNode = kernel->EntryCache->set(kernel->stats->totalTicks, pageEntry);
-          ASSERT(removedNode == LRUEntry);
-        }
+        physicalPageNum = GetFrame(pageEntry);
+        MapFrame(pageEntry, pageFaultPageNum, physicalPageNum);
+        space->PageIn(pageFaultPageNum);
+        space->CacheCodePage(pageFaultPageNum);
       }
 
-      if (kernel->useTLB == TRUE) { // use TLB
-        kernel->machine->UpdateTLB(pageEntry);
-      }
+      kernel->pagingLock->Release();
+      kernel->stats->FaultLatency(kernel->stats->totalTicks - faultStart);
 
       DEBUG(dbgSys, "Memory Referrence Num:" << kernel->stats->memRefNum);
       return;
@@ -546,6 +798,67 @@ ExceptionHandler(ExceptionType which)
     }
                          
       break;
+
+    case ReadOnlyException: { // a write to a page shared since a fork
+      int writeId = (int)kernel->machine->ReadRegister(BadVAddrReg);
+      int writePageNum = writeId / PageSize;
+      AddrSpace *space = kernel->currentThread->space;
+      TranslationEntry *pageEntry = space->getPageEntry(writePageNum);
+      int physicalPageNum;
+
+      if (space->IsCodePage(writePageNum)) { // really read-only
+        cerr << "Write to code at " << writeId << ", process killed\n";
+        SysExit();
+        return;
+        ASSERTNOTREACHED();
+      }
+      kernel->pagingLock->Acquire();
+      if (!pageEntry->valid) { // the page daemon took it while we waited;
+        kernel->pagingLock->Release(); // retry, and fault it back in
+        return;
+      }
+      if (!space->PrivateSwapSlot(writePageNum)) {
+        kernel->pagingLock->Release();
+        cerr << "Out of swap space for a copy-on-write, process killed\n";
+        SysExit();
+        return;
+        ASSERTNOTREACHED();
+      }
+      physicalPageNum = pageEntry->physicalPage;
+      kernel->stats->numCopyOnWriteFaults++;
+
+      // if another address space still maps the page, the writer
+      // takes a copy and leaves the original to the others
+      if (kernel->coreMap[physicalPageNum].owners->NumInList() > 1) {
+        char *buffer = new char[PageSize];
+
+        bcopy(&(kernel->machine->mainMemory[physicalPageNum*PageSize]), buffer, PageSize);
+        space->UnmapPage(writePageNum);
+        physicalPageNum = GetFrame(pageEntry);	// may evict the original
+        MapFrame(pageEntry, writePageNum, physicalPageNum);
+        bcopy(buffer, &(kernel->machine->mainMemory[physicalPageNum*PageSize]), PageSize);
+        delete [] buffer;
+        kernel->stats->numCopyOnWriteCopies++;
+      }
+      pageEntry->readOnly = FALSE;
+      pageEntry->dirty = TRUE;		// only this copy is up to date
+      kernel->coreMap[physicalPageNum].dirty = TRUE;
+      kernel->pagingLock->Release();
+      DEBUG(dbgSys, "Copy on write of page " << writePageNum << " into phy #" << physicalPageNum);
+      return;
+      ASSERTNOTREACHED();
+    }
+
+    case AddressErrorException: { // unaligned, or in no page table leaf
+      int badAddr = (int)kernel->machine->ReadRegister(BadVAddrReg);
+
+      cerr << "Bad address " << badAddr << ", process killed\n";
+      SysExit();
+      return;
+      ASSERTNOTREACHED();
+    }
+
+      break;
     default:
       cerr << "Unexpected user mode exception" << (int)which << "\n";
       break;
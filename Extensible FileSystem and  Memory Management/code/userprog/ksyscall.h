@@ -16,6 +16,14 @@
 #include "synchdisk.h"
 #include "synchconsole.h"
 
+// Store one byte into user memory.  WriteMem fails, after the fault
+// has been handled, if the page was not resident or was shared
+// copy-on-write since a fork; the store then has to be done again.
+void WriteUserByte(int addr, int value) {
+  while (!kernel->machine->WriteMem(addr, 1, value)) {
+  }
+}
+
 bool CheckAndDelete(int id) {
   string name = string(kernel->openFileTable->find(id)->second->getFullName());
   // check delete list.
@@ -52,7 +60,7 @@ int SysSRead(int buffer, int size) { // read content to the buffer
   }
 
   for (int i = 0; i < size; i++) {
-    kernel->machine->WriteMem(buffer, 1, (int)*(content + i));
+    WriteUserByte(buffer, (int)*(content + i));
     if (i == size - 1) {
       break;
     }
@@ -403,7 +411,7 @@ int SysRead(int buffer, int size, OpenFileId id) {
     char str;
     for (int i = 0; i < size; i++) {
       str = kernel->synchConsoleIn->GetChar(); // get the char 
-      kernel->machine->WriteMem(buffer, 1, (int)str); // write to buffer
+      WriteUserByte(buffer, (int)str); // write to buffer
       if (i == size - 1) {
         break;
       }
@@ -443,7 +451,7 @@ int SysRead(int buffer, int size, OpenFileId id) {
 
   //read content
   for (int i = 0; i < size; i++) {
-    kernel->machine->WriteMem(buffer, 1, (int)*(content + i)); // write to buffer
+    WriteUserByte(buffer, (int)*(content + i)); // write to buffer
     if (i == size - 1) {
       break;
     }
@@ -473,6 +481,13 @@ int SysSeek(int position, OpenFileId id) {
   return 1;
 }
 
+int SysSbrk(int increment) {
+  int result = kernel->currentThread->space->Sbrk(increment);
+
+  DEBUG(dbgSys, "[Heap break was " << result << "]");
+  return result;
+}
+
 int SysClose(OpenFileId id) {
   if (kernel->currentThread->space->isExisted(id) == FALSE) { // cannot find
     cout << "Fail, no such id.\n";
@@ -37,6 +37,7 @@
 #define SC_SysRead 16
 #define SC_SysWrite 17
 #define SC_SysFork 18
+#define SC_Sbrk 19
 
 #define SC_Add 42
 
@@ -165,6 +166,12 @@ int SysRead(char* buffer, int size);
 int SysWrite(char* buffer, int size);
 SpaceId SysFork(void(*func)());
 
+/* Grow the heap by "increment" bytes.  Return the old end of the heap,
+ * which is the start of the new memory, or -1 if there is no room.
+ * The new memory is zero.
+ */
+int Sbrk(int increment);
+
 /* Yield the CPU to another runnable thread, whether in this address space 
  * or not. 
  */